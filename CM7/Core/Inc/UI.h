@@ -15,7 +15,12 @@ typedef enum {
   MODE_MOVE = 1,
   MODE_ANCHOR = 2,
   MODE_FOLLOW_SHORE = 3,
-  MOTOR_OVERRIDE = 4
+  MOTOR_OVERRIDE = 4,
+  MOTOR_CALIBRATE = 5,
+  MODE_CRUISE = 6, // MODE_MOVE holding speed over ground
+  MODE_WAYPOINT = 7,
+  MODE_LOITER = 8, // low-energy anchor, drifts inside a radius
+  MODE_ANCHOR_WEATHERVANE = 9 // MODE_ANCHOR turning the bow into the drift
 } operatingMode_t;
 
 typedef enum {
@@ -34,7 +39,7 @@ typedef struct {
   uint8_t override_speed225;
   uint8_t override_speed315;
   bool new_data_flag; // TODO turn into a notification?
-  uint8_t rx_data[7];
+  uint8_t rx_data[8]; // one USART6 frame from the ESP32
 } UIdata;
 
 extern UIdata ui_state;
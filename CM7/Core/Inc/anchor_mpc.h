@@ -0,0 +1,69 @@
+/*
+ * anchor_mpc.h
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  Model-predictive station keeping for MODE_ANCHOR.
+ *
+ *  Surge, sway and yaw are each modelled as a mass with linear drag pushed
+ *  by thrust and by a constant disturbance (current, wind):
+ *    dp/dt = v,   dv/dt = b * u - d * v + w
+ *  At station-keeping speeds the coupling between the axes is small, so the
+ *  three are planned separately in the body frame at the current heading.
+ *
+ *  Each control step an observer updates p, v and w from the measured
+ *  position, then a fixed-horizon plan of thrust steps is found that brings
+ *  p and v to zero against w. The cost is quadratic in state and thrust plus
+ *  an L1 term on thrust, which keeps small errors from being chased with
+ *  thrust at all. The plan is solved with a fixed number of accelerated
+ *  projected-gradient (FISTA) iterations on matrices built once at init, so
+ *  its run time is bounded; it is measured with the DWT cycle counter.
+ */
+
+#ifndef INC_ANCHOR_MPC_H_
+#define INC_ANCHOR_MPC_H_
+
+#include <stdint.h>
+
+#include "thrust_alloc.h"
+
+#define ANCHOR_MPC_AXES          3U   // surge, sway, yaw
+#define ANCHOR_MPC_AXIS_SURGE    0U
+#define ANCHOR_MPC_AXIS_SWAY     1U
+#define ANCHOR_MPC_AXIS_YAW      2U
+
+#define ANCHOR_MPC_HORIZON       10U  // thrust steps planned
+#define ANCHOR_MPC_STEP_S        0.5f // each held for this long
+#define ANCHOR_MPC_ITERATIONS    20U  // solver iterations per control step
+
+typedef struct
+{
+	float position[ANCHOR_MPC_AXES];    // observer estimate: m, m, deg
+	float velocity[ANCHOR_MPC_AXES];    // m/s, m/s, deg/s
+	float disturbance[ANCHOR_MPC_AXES]; // residual after the drift feed-forward,
+	                                    // acceleration (units per s^2)
+	float thrust[ANCHOR_MPC_AXES];      // first planned step, applied
+	uint32_t solve_cycles_last;
+	uint32_t solve_cycles_max;
+} AnchorMpcStatus;
+
+extern AnchorMpcStatus anchor_mpc_status;
+
+// Build the prediction and cost matrices. Call once at start-up.
+void AnchorMpc_Init(void);
+
+// Clear the observer and the previous plan (on anchor mode entry),
+// starting from the given surge, sway and yaw rate (m/s, m/s, deg/s).
+void AnchorMpc_Reset(const float velocity[ANCHOR_MPC_AXES]);
+
+/*
+ * One control step. offset[] is where the boat is relative to the anchor
+ * point: metres ahead, metres to the right, and heading error in degrees
+ * (+ clockwise). drift is the disturbance already known (drift.h) as
+ * thrust; the observer then only estimates what it leaves over. wrench
+ * receives the thrust to apply now.
+ */
+void AnchorMpc_Update(const float offset[ANCHOR_MPC_AXES], const ThrustWrench *drift,
+					  ThrustWrench *wrench);
+
+#endif /* INC_ANCHOR_MPC_H_ */
@@ -0,0 +1,64 @@
+/*
+ * contour.h
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  Depth-contour tracking for MODE_FOLLOW_SHORE.
+ *
+ *  Each sonar depth is stored with the GNSS position it was taken at. A
+ *  plane fitted to the last CONTOUR_HISTORY samples gives the local depth
+ *  gradient and a smoothed depth at the boat. Samples along a straight run
+ *  only show the gradient along it, so the fit is pulled towards the last
+ *  estimate (and at the start towards a slope rising to the chosen shore),
+ *  which keeps the unseen part of the gradient rather than losing it.
+ *
+ *  The isobath at the target depth runs across the gradient, with the shore
+ *  on the chosen side. The course follows it, turned towards the isobath by
+ *  the distance off it (depth error over slope) over a lookahead distance,
+ *  as the waypoint line-of-sight does with cross-track error.
+ */
+
+#ifndef INC_CONTOUR_H_
+#define INC_CONTOUR_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "UI.h"
+
+#define CONTOUR_HISTORY          24U  // about 6 s of sonar
+
+typedef struct
+{
+	float gradient_north;    // cm of depth per m
+	float gradient_east;
+	float depth_cm;          // fitted depth at the boat
+	float cross_track_m;     // off the target isobath, + on the deep side
+	float course_deg;        // to steer
+	uint8_t samples;
+	direction_t shore_side;  // LEFT or RIGHT once known
+	bool valid;              // slope steep enough to follow
+	bool running;            // from Contour_Start until Contour_Stop
+} ContourStatus;
+
+extern ContourStatus contour_status;
+
+/*
+ * Clear the history on entry to MODE_FOLLOW_SHORE or on a new shore side,
+ * not on a speed change from the UI. shore_side LEFT or RIGHT seeds the
+ * gradient with a slope rising that way from heading_deg; anything else
+ * leaves the side to be picked, closest to the heading, once the slope is
+ * known.
+ */
+void Contour_Start(float heading_deg, direction_t shore_side, float target_depth_cm);
+
+// On leaving MODE_FOLLOW_SHORE, so the next entry starts afresh.
+void Contour_Stop(void);
+
+// A new sonar depth, at the current GNSS position.
+void Contour_AddSample(float depth_cm);
+
+// Course along the target isobath. False on a bottom too flat to follow.
+bool Contour_Steer(float *course_deg);
+
+#endif /* INC_CONTOUR_H_ */
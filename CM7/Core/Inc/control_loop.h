@@ -0,0 +1,61 @@
+/*
+ * control_loop.h
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  Fixed-rate control loop. TIM7 wakes the motor control task every
+ *  CONTROL_LOOP_PERIOD_US through a task notification, and the loop keeps
+ *  period jitter, execution time and overrun statistics measured with the
+ *  DWT cycle counter.
+ */
+
+#ifndef INC_CONTROL_LOOP_H_
+#define INC_CONTROL_LOOP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Control rate, 50 - 200 Hz. TIM7 counts at 1 MHz.
+#define CONTROL_LOOP_RATE_HZ        100U
+#define CONTROL_LOOP_PERIOD_US      (1000000U / CONTROL_LOOP_RATE_HZ)
+#define CONTROL_LOOP_DT_S           (1.0f / (float)CONTROL_LOOP_RATE_HZ)
+
+// Execution time histogram for percentiles: 10 us bins, last bin is overflow.
+#define CONTROL_LOOP_HIST_BIN_US    10U
+#define CONTROL_LOOP_HIST_BINS      64U
+
+typedef struct
+{
+	uint32_t steps;
+	uint32_t missed_ticks;      // timer ticks that came while a step was still running
+	uint32_t overruns;          // steps whose execution time exceeded the period
+	uint32_t period_min_us;     // measured time between step starts
+	uint32_t period_max_us;
+	uint32_t jitter_max_us;     // largest |period - CONTROL_LOOP_PERIOD_US|
+	uint32_t wake_latency_max_us; // timer interrupt to task running
+	uint32_t exec_min_us;
+	uint32_t exec_max_us;
+	uint32_t exec_last_us;
+	uint32_t exec_hist[CONTROL_LOOP_HIST_BINS];
+} ControlLoopStats;
+
+extern ControlLoopStats control_loop_stats;
+
+// Start the DWT cycle counter and TIM7. Call from the control task.
+void ControlLoop_Start(void);
+
+// Block until the next timer tick, then time-stamp the step start.
+void ControlLoop_WaitForTick(void);
+
+// Time-stamp the step end and update the statistics.
+void ControlLoop_EndStep(void);
+
+// Execution time (us) below which pct percent of the steps finished.
+uint32_t ControlLoop_ExecPercentileUs(uint8_t pct);
+
+void ControlLoop_ResetStats(void);
+
+// Called from HAL_TIM_PeriodElapsedCallback for TIM7.
+void ControlLoop_TimerISR(void);
+
+#endif /* INC_CONTROL_LOOP_H_ */
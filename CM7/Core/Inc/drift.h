@@ -0,0 +1,54 @@
+/*
+ * drift.h
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  Online estimate of the steady disturbance from current and wind, as the
+ *  thrust it is equivalent to (wrench units, see thrust_alloc.h).
+ *
+ *  Observers compare GNSS velocity and heading with what the commanded
+ *  wrench and a hull drag model predict; the steady part of the difference
+ *  is the disturbance. Drag is the cruise model, thrust = (v / v_full)^2
+ *  per body axis. The translation estimate is kept in the world frame, so it
+ *  stays valid while the boat turns.
+ */
+
+#ifndef INC_DRIFT_H_
+#define INC_DRIFT_H_
+
+#include <stdbool.h>
+
+#include "thrust_alloc.h"
+
+// Feed-forward is withheld until the observers have run this long
+#define DRIFT_SETTLE_S           10.0f
+
+typedef struct
+{
+	float north;      // disturbance, wrench units, world frame
+	float east;
+	float yaw;        // + clockwise
+	float velocity_north; // observer estimates, m/s
+	float velocity_east;
+	float heading_deg;
+	float yaw_rate_dps;
+	float settled_s;  // time the observers have run, up to DRIFT_SETTLE_S
+	bool running;
+} DriftEstimate;
+
+extern DriftEstimate drift_estimate;
+
+/*
+ * One control step. applied is the wrench commanded over the last step, or
+ * NULL if it is unknown (raw motor commands), which holds the estimate.
+ */
+void Drift_Update(const ThrustWrench *applied);
+
+// Disturbance in the body frame at the given heading. Zero until settled.
+void Drift_BodyWrench(float heading_deg, ThrustWrench *disturbance);
+
+// Velocity (m/s, world frame) the boat settles at with the motors off,
+// from the disturbance and the drag model. Zero until settled.
+void Drift_FreeVelocity(float *velocity_north, float *velocity_east);
+
+#endif /* INC_DRIFT_H_ */
@@ -0,0 +1,89 @@
+/*
+ * geofence.h
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  Keep-in and keep-out polygons. Uploaded vertices are converted once to
+ *  local meters (origin at the first vertex) with the edge vectors and
+ *  bounding boxes precomputed, so a query is a few multiply-adds per edge
+ *  and can run every control tick.
+ *
+ *  Upload, ESP32 -> STM32 over USART6 (8-byte frames):
+ *    Byte 0:   0x6C
+ *    Byte 1:   op (GEOFENCE_OP_*)
+ *    BEGIN:    byte 2 = polygon count (0 clears the fence)
+ *    POLYGON:  byte 2 = polygon index, byte 3 = GeofenceType, byte 4 = vertex count
+ *    LAT, LON: byte 2 = polygon index * GEOFENCE_MAX_VERTICES + vertex index,
+ *              byte 3-6 = deg * 1e7 (int32, little endian)
+ *    COMMIT:   byte 2 = polygon count
+ */
+
+#ifndef INC_GEOFENCE_H_
+#define INC_GEOFENCE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define GEOFENCE_MAX_POLYGONS    4U
+#define GEOFENCE_MAX_VERTICES    16U
+
+#define GEOFENCE_ESP32_START     0x6CU
+
+#define GEOFENCE_OP_BEGIN        0x00U
+#define GEOFENCE_OP_POLYGON      0x01U
+#define GEOFENCE_OP_LAT          0x02U
+#define GEOFENCE_OP_LON          0x03U
+#define GEOFENCE_OP_COMMIT       0x04U
+
+typedef enum
+{
+	GEOFENCE_KEEP_IN = 0,
+	GEOFENCE_KEEP_OUT = 1
+} GeofenceType;
+
+typedef struct
+{
+	GeofenceType type;
+	uint8_t vertex_count;
+	float x[GEOFENCE_MAX_VERTICES];   // east, m
+	float y[GEOFENCE_MAX_VERTICES];   // north, m
+	float dx[GEOFENCE_MAX_VERTICES];  // edge i runs from vertex i to i + 1
+	float dy[GEOFENCE_MAX_VERTICES];
+	float inv_len2[GEOFENCE_MAX_VERTICES];
+	float x_per_y[GEOFENCE_MAX_VERTICES]; // edge slope for the crossing test
+	float min_x;
+	float max_x;
+	float min_y;
+	float max_y;
+} GeofencePolygon;
+
+typedef struct
+{
+	double origin_lat;
+	double origin_lon;
+	uint8_t polygon_count;
+	GeofencePolygon polygons[GEOFENCE_MAX_POLYGONS];
+} Geofence;
+
+typedef struct
+{
+	bool violation;        // outside a keep-in or inside a keep-out polygon
+	float margin_m;        // distance to the nearest boundary, negative in violation
+	float push_north;      // unit direction to the safe side of that boundary
+	float push_east;
+	float strength;        // 0 beyond GEOFENCE_MARGIN_M, rising to 1 at the boundary and in violation
+} GeofenceResult;
+
+extern Geofence geofence;
+extern uint32_t geofence_query_cycles_max;
+
+// Handle a 0x6C frame. Called from the USART6 receive interrupt.
+void Geofence_RxFrame(const uint8_t frame[8]);
+
+// Take a newly committed upload and precompute it. Called from the control task.
+void Geofence_Poll(void);
+
+// Returns false when no fence is loaded (result is then cleared).
+bool Geofence_Query(double latitude, double longitude, GeofenceResult *result);
+
+#endif /* INC_GEOFENCE_H_ */
@@ -104,6 +104,7 @@ struct
 	NEDVector3 world_position_avg;
 	NEDVector3 velocity;
 	NEDVector3 rotation;
+	double ground_speed; // 2-D speed over ground in m/s (gSpeed from PVT or HNR)
 	UTCDate utc_date;
 	UTCTime utc_time;
 	byte device_id[5];
@@ -123,9 +124,17 @@ extern volatile bool usart6_tx_complete;
 
 #define ESP32_GPS_TX_LEN 85U
 
+#define GPS_METERS_PER_DEG_LAT 111111.0f
+#define GPS_DEG_TO_RAD         0.01745329252f
+
 void decode_nav(GPSParsedDataStruct *gpds, GPSDataStruct *gds);
 void decode_sec(GPSParsedDataStruct *gpds, GPSDataStruct *gds);
 
 void GPS_PopulateESP32Buffer(GPSDataStruct *gps, uint8_t buf[85]);
 
+// Flat-earth offset (meters) of current from desired; fine over a few km.
+void GPS_CalculateOffsetMeters(double desired_lat, double desired_lon,
+							   double current_lat, double current_lon,
+							   float *north_m, float *east_m);
+
 #endif /* INC_GPS_H_ */
\ No newline at end of file
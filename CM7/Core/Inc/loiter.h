@@ -0,0 +1,89 @@
+/*
+ * loiter.h
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  Loiter: a low-energy anchor (MODE_LOITER). The boat drifts with the
+ *  motors off inside a circle around the entry point. When its drift is
+ *  predicted to leave the circle, one short pulse of thrust takes it back
+ *  to the upstream side, so the next drift crosses the whole circle.
+ *
+ *  Holding a point costs the fixed losses of every running motor all the
+ *  time; loitering pays them only during pulses. Pulse thrust is picked for
+ *  the least energy per metre gained against the drift, from the motor
+ *  power model below (no current sensor: energy is modelled from thrust).
+ *
+ *  Status, STM32 -> ESP32 (8 bytes):
+ *    Byte 0:   0xAD
+ *    Byte 1:   LoiterState
+ *    Byte 2:   radius, m
+ *    Byte 3-4: distance from the centre, dm (uint16, little endian)
+ *    Byte 5-6: average electrical power since entry, W = Wh per hour (uint16)
+ *    Byte 7:   share of the time the motors were on, %
+ */
+
+#ifndef INC_LOITER_H_
+#define INC_LOITER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define LOITER_TELEMETRY_START     0xADU
+#define LOITER_TELEMETRY_TX_LEN    8U
+
+#define LOITER_MIN_RADIUS_M        3.0f
+#define LOITER_MAX_RADIUS_M        100.0f
+
+// Motor power model: fixed losses while running plus full power x
+// thrust^1.5 (momentum theory). Measure on the bench and set.
+#define LOITER_MOTOR_IDLE_POWER_W  15.0f
+#define LOITER_MOTOR_FULL_POWER_W  300.0f
+
+typedef enum
+{
+	LOITER_OFF = 0,
+	LOITER_DRIFTING,
+	LOITER_PULSE
+} LoiterState;
+
+typedef struct
+{
+	LoiterState state;
+	double centre_lat;
+	double centre_lon;
+	float radius_m;
+	float distance_m;        // from the centre
+	float exit_in_s;         // predicted time to leave the circle drifting, s
+	uint32_t pulses;
+	float pulse_s;           // time in the current pulse
+	float motors_on_s;
+	float elapsed_s;
+	float energy_wh;
+} LoiterStatus;
+
+extern LoiterStatus loiter_status;
+
+// Called on entry to MODE_LOITER: the circle is centred on the current position.
+void Loiter_Start(double latitude, double longitude, float radius_m);
+
+// Called on leaving MODE_LOITER; stops the status frames.
+void Loiter_Stop(void);
+
+/*
+ * One control step. Gives the thrust to apply (wrench units, world frame),
+ * zero while drifting. power_w is the electrical power of the last step,
+ * for the energy total.
+ */
+void Loiter_Update(double latitude, double longitude, float power_w,
+				   float *thrust_north, float *thrust_east);
+
+// Modelled electrical power of one motor at thrust 0-1, W.
+float Loiter_MotorPowerW(float thrust);
+
+// Average electrical power since entry, W (energy per hour, Wh/h).
+float Loiter_AveragePowerW(void);
+
+// Send the status frame to the ESP32 if USART6 is free. Called by the GPS task.
+void Loiter_TxTelemetry(void);
+
+#endif /* INC_LOITER_H_ */
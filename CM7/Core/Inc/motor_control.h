@@ -12,6 +12,7 @@
 #include <stdint.h>
 
 #include "UI.h"
+#include "pid.h"
 #include "sonar.h"
 
 typedef struct
@@ -22,12 +23,20 @@ typedef struct
 	direction_t last_drive_direction;
 	float move_desired_heading_deg;
 	bool move_heading_correction_active;
+	PID_t move_heading_pid;
+	bool cruise_enabled;
+	float cruise_target_mps;
+	float cruise_speed_est_mps;
+	PID_t cruise_speed_pid;
+	PID_t waypoint_heading_pid;
 	float follow_desired_heading_deg;
 	bool follow_heading_correction_active;
 	float follow_target_depth_cm;
 	double anchor_desired_latitude;
 	double anchor_desired_longitude;
 	float anchor_desired_heading_deg;
+	bool anchor_weathervane;
+	bool anchor_weathervane_turning;
 	bool anchor_heading_correction_active;
 	bool anchor_position_correction_active;
 } MotorControlState;
@@ -42,23 +51,52 @@ typedef struct
 
 void MotorControl_InitState(MotorControlState *state);
 
+// Once per control step, before the mode: drift estimate (drift.h) from
+// the wrench applied over the last step.
+void MotorControl_UpdateDrift(operatingMode_t mode);
+
+// Once per control step, before the mode: geofence repulsion (geofence.h)
+// for MOVE, CRUISE, FOLLOW_SHORE and WAYPOINT.
+void MotorControl_UpdateGeofence(operatingMode_t mode);
+
 void MotorControl_ModeMove(MotorControlState *state, bool mode_entry, bool got_ui_update,
 													 const UIdata *ui, bool sonar_data_valid, const Sonar_t *sonar,
 											 motor_speed *motor_cmd,
 													 bool *mode_entry_out);
 
-void MotorControl_ModeAnchor(MotorControlState *state, bool mode_entry,
+// weathervane turns the held heading to put the bow into the drift
+// (MODE_ANCHOR_WEATHERVANE) instead of holding the entry heading.
+void MotorControl_ModeAnchor(MotorControlState *state, bool mode_entry, bool weathervane,
 									 motor_speed *motor_cmd,
 														 bool *mode_entry_out);
 
+// Follow the depth contour (contour.h) at the entry depth, shore on the UI
+// side. got_sonar_update marks a new depth in sonar this step.
 void MotorControl_ModeFollowShore(MotorControlState *state, bool mode_entry, bool got_ui_update,
-																	const UIdata *ui, bool sonar_data_valid, const Sonar_t *sonar,
+																	const UIdata *ui, bool sonar_data_valid, bool got_sonar_update,
+																	const Sonar_t *sonar,
 												motor_speed *motor_cmd,
 																	bool *mode_entry_out);
 
 void MotorControl_ModeOverride(const UIdata *ui,
 									 motor_speed *motor_cmd);
 
+// Follow the uploaded route (waypoint.h) at the UI speed.
+void MotorControl_ModeWaypoint(MotorControlState *state, bool mode_entry, const UIdata *ui,
+									motor_speed *motor_cmd,
+									bool *mode_entry_out);
+
+// Drift inside a circle, correcting with short pulses (loiter.h). The UI
+// speed is the radius in metres.
+void MotorControl_ModeLoiter(bool mode_entry, const UIdata *ui,
+								motor_speed *motor_cmd,
+								bool *mode_entry_out);
+
+// Sweep each motor alone and save per-motor thrust tables (thrust_cal.h).
+void MotorControl_ModeCalibrate(bool mode_entry,
+									motor_speed *motor_cmd,
+									bool *mode_entry_out);
+
 void MotorControl_SetOutputs(const motor_speed *motor_cmd);
 
 
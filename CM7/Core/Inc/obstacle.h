@@ -0,0 +1,73 @@
+/*
+ * obstacle.h
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  Radar obstacle tracking and velocity-obstacle avoidance.
+ *
+ *  Each radar packet (up to RADAR_MAX_TARGETS returns, range and bearing
+ *  from the bow) is placed in a local north/east frame from the GNSS
+ *  position and heading and associated to the nearest track. An alpha-beta
+ *  filter per track gives position and velocity over ground, so moving
+ *  obstacles are predicted and not only seen where they are.
+ *
+ *  The planner samples a fixed set of velocities around the commanded one
+ *  (OBSTACLE_PLAN_HEADINGS x OBSTACLE_PLAN_SPEEDS, plus stop). A velocity is
+ *  admissible when, held for OBSTACLE_HORIZON_S, it keeps every track out of
+ *  a disc of OBSTACLE_CLEARANCE_M around the boat. The admissible velocity
+ *  closest to the commanded one wins; a small cost for moving away from the
+ *  last choice keeps the boat passing on the same side. With nothing
+ *  admissible, the velocity that puts off the first contact longest wins.
+ *  The work is bounded by the sample and track counts and is measured with
+ *  the DWT cycle counter.
+ */
+
+#ifndef INC_OBSTACLE_H_
+#define INC_OBSTACLE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define OBSTACLE_MAX_TRACKS      6U
+
+#define OBSTACLE_HORIZON_S       10.0f
+#define OBSTACLE_CLEARANCE_M     3.0f   // boat and obstacle radii plus margin
+#define OBSTACLE_PLAN_HEADINGS   13U    // every 15 deg, up to 90 deg either side
+#define OBSTACLE_PLAN_SPEEDS     3U     // full, two thirds, one third
+
+typedef struct
+{
+	bool active;
+	bool confirmed;          // seen on OBSTACLE_CONFIRM_HITS scans
+	uint8_t hits;
+	float north;             // m, local frame (ObstacleStatus origin)
+	float east;
+	float velocity_north;    // m/s over ground
+	float velocity_east;
+	uint32_t last_seen_ms;
+} ObstacleTrack;
+
+typedef struct
+{
+	ObstacleTrack track[OBSTACLE_MAX_TRACKS];
+	double origin_lat;       // local frame, moved to the boat while no tracks
+	double origin_lon;
+	bool avoiding;           // last plan changed the commanded velocity
+	uint32_t plan_cycles_last;
+	uint32_t plan_cycles_max;
+} ObstacleStatus;
+
+extern ObstacleStatus obstacle_status;
+
+// Once per control step: predict the tracks and fold in a new radar packet.
+// Tracks are dropped while the radar is off.
+void Obstacle_Update(void);
+
+/*
+ * Velocity to steer for (m/s, world frame) given the commanded one. Returns
+ * true when the commanded velocity is not admissible and chosen differs.
+ */
+bool Obstacle_PlanVelocity(float preferred_north, float preferred_east,
+						   float *chosen_north, float *chosen_east);
+
+#endif /* INC_OBSTACLE_H_ */
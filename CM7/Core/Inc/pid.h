@@ -0,0 +1,47 @@
+/*
+ * pid.h
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  Discrete PID controller with output limits, anti-windup and a low-pass
+ *  filtered derivative, for a fixed sample time (see control_loop.h).
+ */
+
+#ifndef INC_PID_H_
+#define INC_PID_H_
+
+#include <stdbool.h>
+
+typedef struct
+{
+	float kp;
+	float ki; // per second
+	float kd; // seconds
+	float dt_s;
+	float d_filter_tau_s; // derivative low-pass time constant, 0 = unfiltered
+	float out_min;
+	float out_max;
+
+	float integrator;
+	float prev_error;
+	float derivative;
+	bool initialized;
+} PID_t;
+
+void PID_Init(PID_t *pid, float kp, float ki, float kd, float dt_s, float d_filter_tau_s,
+			  float out_min, float out_max);
+
+// Clear the integrator and derivative history (e.g. on mode entry).
+void PID_Reset(PID_t *pid);
+
+/*
+ * One step on error = setpoint - measurement. The caller computes the error
+ * so angles can be wrapped first.
+ *
+ * The integrator only moves when the output is not saturated, or when the
+ * error drives the output back out of saturation, so it does not wind up
+ * while the thrusters are at their limit.
+ */
+float PID_Update(PID_t *pid, float error);
+
+#endif /* INC_PID_H_ */
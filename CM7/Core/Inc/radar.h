@@ -17,17 +17,78 @@ typedef struct
     float distance; // meters
     float angle_deg; // degrees
     float quality; // accuracy
+    float velocity_mps; // range rate, negative = closing
     bool radar_state; // ON = TRUE, OFF = FALSE
     bool radar_state_prev;
 } RadarData;
 
+#define RADAR_MAX_TARGETS 4
+#define RADAR_RX_LINE_MAX 256
+
+typedef struct
+{
+    float distance; // meters
+    float angle_deg; // degrees
+    float quality; // 0 - 1
+    float velocity_mps; // range rate, negative = closing
+} RadarTarget;
+
+#define RADAR_PROFILE_MAX_BINS 48
+
+// Range profile streamed by the Pi ("#P" lines): strongest return in every
+// range bin, so all returns can be mapped and not only the detections.
+typedef struct
+{
+    uint16_t seq;
+    uint8_t bins;
+    float start_m; // range of bin 0
+    float step_m; // range between bins
+    float floor_db; // level 0
+    uint8_t level[RADAR_PROFILE_MAX_BINS]; // 0.5 dB steps above floor_db
+    int8_t angle_deg[RADAR_PROFILE_MAX_BINS];
+    uint32_t update_ms;
+} RadarRangeProfile;
+
+#define RADAR_PARAM_OP_GET 0U
+#define RADAR_PARAM_OP_SET 1U
+
+#define RADAR_PARAM_ESP32_START 0xABU
+#define RADAR_PARAM_ESP32_TX_LEN 8U
+
+// Radar parameter get / set from the ESP32 UI, relayed to the Pi as
+// "#S,id,value" / "#G,id". The ids are RADAR_PARAMS in radar_usb.py.
+typedef struct
+{
+    volatile bool pending;
+    uint8_t op; // RADAR_PARAM_OP_*
+    uint8_t id;
+    float value;
+} RadarParamRequest;
+
+// Pi answer ("#V,id,value,status"), forwarded to the ESP32 as
+// [0xAB][id][value float LE][status][0]
+typedef struct
+{
+    volatile bool pending;
+    uint8_t id;
+    float value; // value in use on the Pi
+    uint8_t status; // 0 = ok, 1 = unknown id, 2 = rejected
+} RadarParamReply;
+
 extern bool radar_task_update;
 extern uint32_t radar_last_update_ms;
 
 // #define RADAR_ID 0x67
 
 extern RadarData radar_detections;
-void usb_radar_rx(uint8_t *buf);
+extern RadarTarget radar_targets[RADAR_MAX_TARGETS];
+extern uint8_t radar_target_count;
+extern RadarRangeProfile radar_profile;
+extern RadarParamRequest radar_param_request;
+extern RadarParamReply radar_param_reply;
+void usb_radar_rx(uint8_t *buf, uint32_t len);
 void usb_radar_tx_state();
+void usb_radar_tx_param(void);
+void usart6_radar_tx_param_reply(void);
 
 #endif /* INC_RADAR_H_ */
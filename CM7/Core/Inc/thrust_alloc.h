@@ -0,0 +1,54 @@
+/*
+ * thrust_alloc.h
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  Maps a desired body wrench (surge, sway, yaw) to the four one-directional
+ *  thrusters at 45, 135, 225 and 315 degrees.
+ */
+
+#ifndef INC_THRUST_ALLOC_H_
+#define INC_THRUST_ALLOC_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define THRUST_ALLOC_MOTORS      4U
+
+// Index of each thruster in the thrust arrays
+#define THRUST_ALLOC_MOTOR_45    0U
+#define THRUST_ALLOC_MOTOR_135   1U
+#define THRUST_ALLOC_MOTOR_225   2U
+#define THRUST_ALLOC_MOTOR_315   3U
+
+// Thrust is normalized per motor: 0 = motor at the edge of its deadband,
+// 1 = full command. A motor asked for less than this is switched off rather
+// than idled at the deadband edge, where it draws current for no thrust.
+#define THRUST_ALLOC_MIN_THRUST  0.005f
+
+// Body wrench. One unit on an axis is what a pair of thrusters at full
+// thrust gives, e.g. surge = 1 is 135 + 225 at full.
+typedef struct
+{
+	float surge; // + forward
+	float sway;  // + right
+	float yaw;   // + clockwise
+} ThrustWrench;
+
+/*
+ * Allocate a wrench to the four thrusters.
+ *
+ * thrust[] receives 0-1 per motor (THRUST_ALLOC_MOTOR_* order). If the wrench
+ * cannot be reached, yaw is kept first, then sway, then surge, each scaled
+ * down only as far as needed. achieved (optional) receives the wrench the
+ * returned thrusts produce.
+ *
+ * Returns true if any axis had to be scaled down.
+ */
+bool ThrustAlloc_Solve(const ThrustWrench *desired, float thrust[THRUST_ALLOC_MOTORS],
+					   ThrustWrench *achieved);
+
+// Wrench produced by a set of motor thrusts.
+void ThrustAlloc_Forward(const float thrust[THRUST_ALLOC_MOTORS], ThrustWrench *wrench);
+
+#endif /* INC_THRUST_ALLOC_H_ */
@@ -0,0 +1,82 @@
+/*
+ * thrust_cal.h
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  Per-motor thrust linearization. Each thruster has a lookup table from
+ *  normalized thrust (0-1, see thrust_alloc.h) to its 0-255 motor command,
+ *  kept in the last flash sector of bank 1. A calibration sweep builds the
+ *  tables on the water.
+ */
+
+#ifndef INC_THRUST_CAL_H_
+#define INC_THRUST_CAL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "thrust_alloc.h"
+
+// Table points at thrust 0, 0.1, ... 1.0
+#define THRUST_CAL_POINTS        11U
+
+// Calibration sweep: step 0 is motor off (baseline), then evenly spaced
+// commands from THRUST_CAL_SWEEP_MIN_CMD to 255. The sweep starts below the
+// nominal deadband so each motor's own start point is found.
+#define THRUST_CAL_SWEEP_STEPS   17U
+#define THRUST_CAL_SWEEP_MIN_CMD 40U
+
+typedef enum
+{
+	THRUST_CAL_DEFAULT = 0, // nominal linear tables, nothing valid in flash
+	THRUST_CAL_LOADED,      // tables loaded from flash
+	THRUST_CAL_RUNNING,     // calibration sweep in progress
+	THRUST_CAL_DONE,        // sweep finished and tables saved
+	THRUST_CAL_FAILED       // sweep or flash write failed, previous tables kept
+} ThrustCalStatus;
+
+typedef struct
+{
+	uint32_t magic;
+	uint32_t version;
+	uint8_t cmd[THRUST_ALLOC_MOTORS][THRUST_CAL_POINTS];
+	float full_response[THRUST_ALLOC_MOTORS]; // yaw rate at full command, deg/s
+	uint32_t checksum;
+} ThrustCalTable;
+
+// Sweep progress and raw results, kept for inspection in the debugger
+typedef struct
+{
+	uint8_t motor;
+	uint8_t step;
+	uint32_t step_ticks;
+	float heading_prev_deg;
+	float heading_travel_deg;
+	float yaw_rate_deg_s[THRUST_ALLOC_MOTORS][THRUST_CAL_SWEEP_STEPS];
+} ThrustCalSweep;
+
+extern ThrustCalStatus thrust_cal_status;
+extern ThrustCalTable thrust_cal_table;
+extern ThrustCalSweep thrust_cal_sweep;
+
+// Load the tables from flash, or fall back to the nominal linear model.
+void ThrustCal_Init(void);
+
+// Motor command (0-255) that gives the requested normalized thrust.
+uint8_t ThrustCal_ThrustToCmd(uint8_t motor, float thrust);
+
+// Restart the calibration sweep.
+void ThrustCal_Start(void);
+
+/*
+ * One control loop step of the sweep. Fills cmd[] with the motor commands
+ * to output (indexed by THRUST_ALLOC_MOTOR_*) from the current heading.
+ * Returns false once the sweep has finished (cmd[] is then all zero).
+ *
+ * Each motor is run alone through the sweep and the steady yaw rate it
+ * causes is recorded. With yaw drag roughly quadratic in rate, thrust is
+ * taken as proportional to rate squared.
+ */
+bool ThrustCal_Step(float heading_deg, uint8_t cmd[THRUST_ALLOC_MOTORS]);
+
+#endif /* INC_THRUST_CAL_H_ */
@@ -51,6 +51,7 @@ void MX_USART6_UART_Init(void);
 
 /* USER CODE BEGIN Prototypes */
 void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart);
+bool USART6_ClaimTx(void);
 /* USER CODE END Prototypes */
 
 #ifdef __cplusplus
@@ -0,0 +1,94 @@
+/*
+ * waypoint.h
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  Waypoint route storage, upload from the ESP32 and line-of-sight
+ *  guidance for MODE_WAYPOINT.
+ *
+ *  Route upload, ESP32 -> STM32 over USART6 (8-byte frames):
+ *    Byte 0:   0x6B
+ *    Byte 1:   op (WAYPOINT_OP_*)
+ *    Byte 2:   waypoint index, or count for BEGIN / COMMIT
+ *    Byte 3-6: latitude or longitude, deg * 1e7 (int32, little endian)
+ *    Byte 7:   0
+ *
+ *  Progress telemetry, STM32 -> ESP32:
+ *    Byte 0:   0xAC
+ *    Byte 1:   active waypoint index
+ *    Byte 2:   waypoint count
+ *    Byte 3:   WaypointState, | WAYPOINT_TELEMETRY_REJECTED while the last
+ *              upload was rejected
+ *    Byte 4-5: distance to the active waypoint, dm (uint16, little endian)
+ *    Byte 6-7: cross-track error, dm, + right of track (int16, little endian)
+ */
+
+#ifndef INC_WAYPOINT_H_
+#define INC_WAYPOINT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define WAYPOINT_MAX                 32U
+
+#define WAYPOINT_ESP32_START         0x6BU
+#define WAYPOINT_TELEMETRY_START     0xACU
+#define WAYPOINT_TELEMETRY_TX_LEN    8U
+#define WAYPOINT_TELEMETRY_REJECTED  0x80U
+
+#define WAYPOINT_OP_BEGIN            0x00U
+#define WAYPOINT_OP_LAT              0x01U
+#define WAYPOINT_OP_LON              0x02U
+#define WAYPOINT_OP_COMMIT           0x03U
+
+typedef enum
+{
+	WAYPOINT_NO_ROUTE = 0,
+	WAYPOINT_READY,          // route loaded, not started
+	WAYPOINT_ACTIVE,         // navigating
+	WAYPOINT_ARRIVED         // final waypoint reached
+} WaypointState;
+
+typedef struct
+{
+	double latitude[WAYPOINT_MAX];
+	double longitude[WAYPOINT_MAX];
+	uint8_t count;
+} WaypointRoute;
+
+typedef struct
+{
+	WaypointState state;
+	bool upload_rejected;   // last upload was incomplete, previous route kept
+	uint8_t active_index;
+	float distance_m;       // to the active waypoint
+	float cross_track_m;    // + right of the track
+	float heading_sp_deg;
+	float speed_sp_mps;
+} WaypointStatus;
+
+extern WaypointRoute waypoint_route;
+extern WaypointStatus waypoint_status;
+
+// Handle a 0x6B frame. Called from the USART6 receive interrupt.
+void Waypoint_RxFrame(const uint8_t frame[8]);
+
+/*
+ * Called on entry to MODE_WAYPOINT. Takes a newly uploaded route, and
+ * (re)starts from the first waypoint unless a route is already in progress.
+ * The first leg runs from the current position.
+ */
+void Waypoint_Start(double latitude, double longitude);
+
+/*
+ * Line-of-sight guidance from the current position. Gives the heading and
+ * speed setpoints (speed at most cruise_mps). Returns false when there is
+ * nothing to steer for (no route, or the final waypoint has been reached).
+ */
+bool Waypoint_Update(double latitude, double longitude, float cruise_mps,
+					 float *heading_sp_deg, float *speed_sp_mps);
+
+// Send the progress frame to the ESP32 if USART6 is free. Called by the GPS task.
+void Waypoint_TxTelemetry(void);
+
+#endif /* INC_WAYPOINT_H_ */
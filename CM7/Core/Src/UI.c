@@ -21,5 +21,5 @@ UIdata ui_state = {
     .rx_data = { 0 }
 };
 
-const char* mode_str[] = {"DISABLE", "MOVE", "ANCHOR", "FOLLOW_SHORE", "MOTOR_OVERRIDE"};
+const char* mode_str[] = {"DISABLE", "MOVE", "ANCHOR", "FOLLOW_SHORE", "MOTOR_OVERRIDE", "MOTOR_CALIBRATE", "CRUISE", "WAYPOINT", "LOITER", "ANCHOR_WEATHERVANE"};
 const char* dir_str[] = {"LEFT", "RIGHT", "FORWARD", "REVERSE"};
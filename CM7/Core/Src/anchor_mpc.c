@@ -0,0 +1,317 @@
+/*
+ * anchor_mpc.c
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include "anchor_mpc.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "control_loop.h"
+#include "stm32h7xx_hal.h"
+
+#define ANCHOR_MPC_N             ANCHOR_MPC_HORIZON
+
+// Planned thrust per axis, in wrench units (see thrust_alloc.h)
+#define ANCHOR_MPC_THRUST_LIMIT  0.5f
+
+// Power iterations for the solver step size, and margin on the result
+#define ANCHOR_MPC_POWER_ITERATIONS 40U
+#define ANCHOR_MPC_STEP_MARGIN   1.05f
+
+typedef struct
+{
+	// Model: dv/dt = b * u - d * v + w
+	float b;
+	float d;
+	// Cost per planned step, terminal weights on the last one
+	float q_position;
+	float q_velocity;
+	float q_position_end;
+	float q_velocity_end;
+	float r_thrust;
+	float l1_thrust;
+	// Observer bandwidth, rad/s
+	float observer_w;
+} AnchorMpcAxisConfig;
+
+/*
+ * Surge: about 1.8 m/s at full thrust, as in the cruise feed-forward.
+ * Sway: more drag and less thrust from the same pair.
+ * Yaw: in degrees, about 40 deg/s at full thrust.
+ */
+static const AnchorMpcAxisConfig anchor_mpc_config[ANCHOR_MPC_AXES] =
+{
+	{ 0.9f,  0.5f, 1.0f,  1.0f,  5.0f,  5.0f,  2.0f, 0.05f, 1.5f },
+	{ 0.6f,  1.0f, 1.0f,  1.0f,  5.0f,  5.0f,  2.0f, 0.05f, 1.5f },
+	{ 60.0f, 1.5f, 0.01f, 0.01f, 0.05f, 0.05f, 2.0f, 0.05f, 3.0f },
+};
+
+typedef struct
+{
+	// Cost 1/2 u'Hu + (Gz)'u over the plan u, with z = (p, v, w) now
+	float h[ANCHOR_MPC_N][ANCHOR_MPC_N];
+	float g[ANCHOR_MPC_N][3];
+	float step;       // 1 / largest eigenvalue of H
+	float l1_step;    // l1_thrust * step, the soft threshold
+	float observer_l[3];
+	float plan[ANCHOR_MPC_N];
+} AnchorMpcAxis;
+
+AnchorMpcStatus anchor_mpc_status;
+
+static AnchorMpcAxis anchor_mpc_axis[ANCHOR_MPC_AXES];
+// FISTA momentum per iteration, the same every solve
+static float anchor_mpc_momentum[ANCHOR_MPC_ITERATIONS];
+
+static void AnchorMpc_BuildAxis(const AnchorMpcAxisConfig *cfg, AnchorMpcAxis *axis)
+{
+	// Exact discretization over one planned step with u and w held
+	float ed = expf(-cfg->d * ANCHOR_MPC_STEP_S);
+	float k1 = (1.0f - ed) / cfg->d;
+	float k2 = (ANCHOR_MPC_STEP_S - k1) / cfg->d;
+	// x+ = A x + B u + E w, x = (p, v)
+	float a[2][2] = { { 1.0f, k1 }, { 0.0f, ed } };
+	float e[2] = { k2, k1 };
+
+	// response[m] = A^m B, the effect of one thrust step m steps later
+	float response[ANCHOR_MPC_N][2];
+	// free[k] = the state after k + 1 steps from z = (p, v, w), u = 0
+	float free[ANCHOR_MPC_N][2][3];
+	float ak[2][2] = { { 1.0f, 0.0f }, { 0.0f, 1.0f } };
+	float wsum[2] = { 0.0f, 0.0f };
+
+	for (uint8_t k = 0U; k < ANCHOR_MPC_N; k++)
+	{
+		response[k][0] = ((ak[0][0] * e[0]) + (ak[0][1] * e[1])) * cfg->b;
+		response[k][1] = ((ak[1][0] * e[0]) + (ak[1][1] * e[1])) * cfg->b;
+
+		wsum[0] += (ak[0][0] * e[0]) + (ak[0][1] * e[1]);
+		wsum[1] += (ak[1][0] * e[0]) + (ak[1][1] * e[1]);
+
+		float next[2][2];
+		next[0][0] = (a[0][0] * ak[0][0]) + (a[0][1] * ak[1][0]);
+		next[0][1] = (a[0][0] * ak[0][1]) + (a[0][1] * ak[1][1]);
+		next[1][0] = (a[1][0] * ak[0][0]) + (a[1][1] * ak[1][0]);
+		next[1][1] = (a[1][0] * ak[0][1]) + (a[1][1] * ak[1][1]);
+		memcpy(ak, next, sizeof(ak));
+
+		for (uint8_t r = 0U; r < 2U; r++)
+		{
+			free[k][r][0] = ak[r][0];
+			free[k][r][1] = ak[r][1];
+			free[k][r][2] = wsum[r];
+		}
+	}
+
+	// Thrust step i reaches the state after step k (k >= i) through
+	// response[k - i].
+	memset(axis, 0, sizeof(*axis));
+	for (uint8_t k = 0U; k < ANCHOR_MPC_N; k++)
+	{
+		bool end = ((k + 1U) == ANCHOR_MPC_N);
+		float qp = end ? cfg->q_position_end : cfg->q_position;
+		float qv = end ? cfg->q_velocity_end : cfg->q_velocity;
+
+		for (uint8_t i = 0U; i <= k; i++)
+		{
+			const float *ri = response[k - i];
+
+			for (uint8_t j = 0U; j <= k; j++)
+			{
+				const float *rj = response[k - j];
+				axis->h[i][j] += 2.0f * ((qp * ri[0] * rj[0]) + (qv * ri[1] * rj[1]));
+			}
+			for (uint8_t c = 0U; c < 3U; c++)
+			{
+				axis->g[i][c] += 2.0f * ((qp * ri[0] * free[k][0][c]) + (qv * ri[1] * free[k][1][c]));
+			}
+		}
+	}
+	for (uint8_t i = 0U; i < ANCHOR_MPC_N; i++)
+	{
+		axis->h[i][i] += 2.0f * cfg->r_thrust;
+	}
+
+	// Largest eigenvalue of H by power iteration
+	float x[ANCHOR_MPC_N];
+	float norm = 0.0f;
+	for (uint8_t i = 0U; i < ANCHOR_MPC_N; i++)
+	{
+		x[i] = 1.0f;
+	}
+	for (uint8_t it = 0U; it < ANCHOR_MPC_POWER_ITERATIONS; it++)
+	{
+		float y[ANCHOR_MPC_N];
+		norm = 0.0f;
+		for (uint8_t i = 0U; i < ANCHOR_MPC_N; i++)
+		{
+			y[i] = 0.0f;
+			for (uint8_t j = 0U; j < ANCHOR_MPC_N; j++)
+			{
+				y[i] += axis->h[i][j] * x[j];
+			}
+			norm += y[i] * y[i];
+		}
+		norm = sqrtf(norm);
+		for (uint8_t i = 0U; i < ANCHOR_MPC_N; i++)
+		{
+			x[i] = y[i] / norm;
+		}
+	}
+	axis->step = 1.0f / (norm * ANCHOR_MPC_STEP_MARGIN);
+	axis->l1_step = cfg->l1_thrust * axis->step;
+
+	// Observer poles all at -observer_w
+	float w = cfg->observer_w;
+	axis->observer_l[0] = (3.0f * w) - cfg->d;
+	axis->observer_l[1] = (3.0f * w * w) - (cfg->d * axis->observer_l[0]);
+	axis->observer_l[2] = w * w * w;
+}
+
+void AnchorMpc_Init(void)
+{
+	float t = 1.0f;
+
+	for (uint8_t a = 0U; a < ANCHOR_MPC_AXES; a++)
+	{
+		AnchorMpc_BuildAxis(&anchor_mpc_config[a], &anchor_mpc_axis[a]);
+	}
+
+	for (uint8_t it = 0U; it < ANCHOR_MPC_ITERATIONS; it++)
+	{
+		float t_next = 0.5f * (1.0f + sqrtf(1.0f + (4.0f * t * t)));
+		anchor_mpc_momentum[it] = (t - 1.0f) / t_next;
+		t = t_next;
+	}
+
+	memset(&anchor_mpc_status, 0, sizeof(anchor_mpc_status));
+}
+
+void AnchorMpc_Reset(const float velocity[ANCHOR_MPC_AXES])
+{
+	uint32_t cycles_max = anchor_mpc_status.solve_cycles_max;
+
+	memset(&anchor_mpc_status, 0, sizeof(anchor_mpc_status));
+	anchor_mpc_status.solve_cycles_max = cycles_max;
+
+	for (uint8_t a = 0U; a < ANCHOR_MPC_AXES; a++)
+	{
+		anchor_mpc_status.velocity[a] = velocity[a];
+		memset(anchor_mpc_axis[a].plan, 0, sizeof(anchor_mpc_axis[a].plan));
+	}
+}
+
+// Position-driven observer for p, v and w, one control step
+static void AnchorMpc_Observe(uint8_t a, float measured, float drift)
+{
+	const AnchorMpcAxisConfig *cfg = &anchor_mpc_config[a];
+	const float *l = anchor_mpc_axis[a].observer_l;
+	float *p = &anchor_mpc_status.position[a];
+	float *v = &anchor_mpc_status.velocity[a];
+	float *w = &anchor_mpc_status.disturbance[a];
+	float err = measured - *p;
+	float accel = (cfg->b * (anchor_mpc_status.thrust[a] + drift)) - (cfg->d * *v) + *w;
+
+	*p += CONTROL_LOOP_DT_S * (*v + (l[0] * err));
+	*v += CONTROL_LOOP_DT_S * (accel + (l[1] * err));
+	*w += CONTROL_LOOP_DT_S * l[2] * err;
+}
+
+/*
+ * Minimize 1/2 u'Hu + f'u + l1 |u| with |u| <= limit. Each iteration is a
+ * gradient step, a soft threshold for the L1 term and a clip to the limit,
+ * with Nesterov momentum. Warm-started from the previous plan.
+ */
+static void AnchorMpc_Solve(AnchorMpcAxis *axis, const float f[ANCHOR_MPC_N])
+{
+	float y[ANCHOR_MPC_N];
+	float *u = axis->plan;
+
+	memcpy(y, u, sizeof(y));
+
+	for (uint8_t it = 0U; it < ANCHOR_MPC_ITERATIONS; it++)
+	{
+		float next[ANCHOR_MPC_N];
+
+		for (uint8_t i = 0U; i < ANCHOR_MPC_N; i++)
+		{
+			float grad = f[i];
+			for (uint8_t j = 0U; j < ANCHOR_MPC_N; j++)
+			{
+				grad += axis->h[i][j] * y[j];
+			}
+
+			float x = y[i] - (axis->step * grad);
+			if (x > axis->l1_step)
+			{
+				x -= axis->l1_step;
+			}
+			else if (x < -axis->l1_step)
+			{
+				x += axis->l1_step;
+			}
+			else
+			{
+				x = 0.0f;
+			}
+
+			if (x > ANCHOR_MPC_THRUST_LIMIT)
+			{
+				x = ANCHOR_MPC_THRUST_LIMIT;
+			}
+			else if (x < -ANCHOR_MPC_THRUST_LIMIT)
+			{
+				x = -ANCHOR_MPC_THRUST_LIMIT;
+			}
+			next[i] = x;
+		}
+
+		for (uint8_t i = 0U; i < ANCHOR_MPC_N; i++)
+		{
+			y[i] = next[i] + (anchor_mpc_momentum[it] * (next[i] - u[i]));
+			u[i] = next[i];
+		}
+	}
+}
+
+void AnchorMpc_Update(const float offset[ANCHOR_MPC_AXES], const ThrustWrench *drift,
+					  ThrustWrench *wrench)
+{
+	uint32_t start = DWT->CYCCNT;
+	float feed_forward[ANCHOR_MPC_AXES] = { drift->surge, drift->sway, drift->yaw };
+
+	for (uint8_t a = 0U; a < ANCHOR_MPC_AXES; a++)
+	{
+		AnchorMpcAxis *axis = &anchor_mpc_axis[a];
+		float z[3];
+		float f[ANCHOR_MPC_N];
+
+		AnchorMpc_Observe(a, offset[a], feed_forward[a]);
+
+		z[0] = anchor_mpc_status.position[a];
+		z[1] = anchor_mpc_status.velocity[a];
+		z[2] = anchor_mpc_status.disturbance[a] + (anchor_mpc_config[a].b * feed_forward[a]);
+
+		for (uint8_t i = 0U; i < ANCHOR_MPC_N; i++)
+		{
+			f[i] = (axis->g[i][0] * z[0]) + (axis->g[i][1] * z[1]) + (axis->g[i][2] * z[2]);
+		}
+
+		AnchorMpc_Solve(axis, f);
+		anchor_mpc_status.thrust[a] = axis->plan[0];
+	}
+
+	// Model signs: + thrust moves the boat + on the axis
+	wrench->surge = anchor_mpc_status.thrust[ANCHOR_MPC_AXIS_SURGE];
+	wrench->sway = anchor_mpc_status.thrust[ANCHOR_MPC_AXIS_SWAY];
+	wrench->yaw = anchor_mpc_status.thrust[ANCHOR_MPC_AXIS_YAW];
+
+	anchor_mpc_status.solve_cycles_last = DWT->CYCCNT - start;
+	if (anchor_mpc_status.solve_cycles_last > anchor_mpc_status.solve_cycles_max)
+	{
+		anchor_mpc_status.solve_cycles_max = anchor_mpc_status.solve_cycles_last;
+	}
+}
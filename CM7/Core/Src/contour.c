@@ -0,0 +1,207 @@
+/*
+ * contour.c
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include "contour.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "gps.h"
+
+// Seed slope for a known shore side, cm per m (5%)
+#define CONTOUR_PRIOR_GRADIENT   5.0f
+// Pull of the last gradient in the fit, as the spread of samples (m^2) it
+// is worth. Higher is steadier but slower to follow a changing slope.
+#define CONTOUR_PRIOR_WEIGHT_M2  10.0f
+// Flatter than this, cm per m, there is no contour to follow
+#define CONTOUR_MIN_GRADIENT     1.0f
+#define CONTOUR_MIN_SAMPLES      6U
+// Line-of-sight lookahead, and the most the isobath is taken to be off:
+// a slope near the minimum turns small depth errors into large distances.
+#define CONTOUR_LOOKAHEAD_M      8.0f
+#define CONTOUR_MAX_OFFSET_M     20.0f
+
+#define CONTOUR_RAD_TO_DEG       57.2957795f
+
+ContourStatus contour_status;
+
+typedef struct
+{
+	double origin_lat;
+	double origin_lon;
+	float north[CONTOUR_HISTORY];  // m from the origin
+	float east[CONTOUR_HISTORY];
+	float depth[CONTOUR_HISTORY];  // cm
+	uint8_t next;
+	float target_depth_cm;
+	// Centre of the last fit
+	float mean_north;
+	float mean_east;
+	float mean_depth;
+} ContourHistory;
+
+static ContourHistory contour_history;
+
+static void Contour_Position(float *north, float *east)
+{
+	GPS_CalculateOffsetMeters(contour_history.origin_lat, contour_history.origin_lon,
+							  GPS_Data.world_position_avg.N, GPS_Data.world_position_avg.E,
+							  north, east);
+}
+
+void Contour_Start(float heading_deg, direction_t shore_side, float target_depth_cm)
+{
+	float th = heading_deg * GPS_DEG_TO_RAD;
+
+	memset(&contour_history, 0, sizeof(contour_history));
+	memset(&contour_status, 0, sizeof(contour_status));
+	contour_history.origin_lat = GPS_Data.world_position_avg.N;
+	contour_history.origin_lon = GPS_Data.world_position_avg.E;
+	contour_history.target_depth_cm = target_depth_cm;
+	contour_status.shore_side = shore_side;
+	contour_status.running = true;
+
+	// Deeper away from the shore: to the left of the heading for a shore on
+	// the right, and the other way round
+	if (shore_side == RIGHT)
+	{
+		contour_status.gradient_north = CONTOUR_PRIOR_GRADIENT * sinf(th);
+		contour_status.gradient_east = -CONTOUR_PRIOR_GRADIENT * cosf(th);
+	}
+	else if (shore_side == LEFT)
+	{
+		contour_status.gradient_north = -CONTOUR_PRIOR_GRADIENT * sinf(th);
+		contour_status.gradient_east = CONTOUR_PRIOR_GRADIENT * cosf(th);
+	}
+}
+
+void Contour_Stop(void)
+{
+	contour_status.running = false;
+}
+
+void Contour_AddSample(float depth_cm)
+{
+	ContourHistory *h = &contour_history;
+
+	Contour_Position(&h->north[h->next], &h->east[h->next]);
+	h->depth[h->next] = depth_cm;
+	h->next = (uint8_t)((h->next + 1U) % CONTOUR_HISTORY);
+	if (contour_status.samples < CONTOUR_HISTORY)
+	{
+		contour_status.samples++;
+	}
+
+	uint8_t n = contour_status.samples;
+	float mn = 0.0f;
+	float me = 0.0f;
+	float md = 0.0f;
+
+	for (uint8_t i = 0U; i < n; i++)
+	{
+		mn += h->north[i];
+		me += h->east[i];
+		md += h->depth[i];
+	}
+	mn /= (float)n;
+	me /= (float)n;
+	md /= (float)n;
+
+	// Plane fit about the centre, pulled towards the last gradient:
+	// (S + mu I) g = s + mu g_last
+	float snn = CONTOUR_PRIOR_WEIGHT_M2;
+	float sne = 0.0f;
+	float see = CONTOUR_PRIOR_WEIGHT_M2;
+	float sn = CONTOUR_PRIOR_WEIGHT_M2 * contour_status.gradient_north;
+	float se = CONTOUR_PRIOR_WEIGHT_M2 * contour_status.gradient_east;
+
+	for (uint8_t i = 0U; i < n; i++)
+	{
+		float dn = h->north[i] - mn;
+		float de = h->east[i] - me;
+		float dd = h->depth[i] - md;
+
+		snn += dn * dn;
+		sne += dn * de;
+		see += de * de;
+		sn += dn * dd;
+		se += de * dd;
+	}
+
+	// Positive definite: the prior weight is on the diagonal
+	float det = (snn * see) - (sne * sne);
+	contour_status.gradient_north = ((see * sn) - (sne * se)) / det;
+	contour_status.gradient_east = ((snn * se) - (sne * sn)) / det;
+
+	h->mean_north = mn;
+	h->mean_east = me;
+	h->mean_depth = md;
+}
+
+bool Contour_Steer(float *course_deg)
+{
+	float gn = contour_status.gradient_north;
+	float ge = contour_status.gradient_east;
+	float slope = sqrtf((gn * gn) + (ge * ge));
+
+	contour_status.valid = (contour_status.samples >= CONTOUR_MIN_SAMPLES) && (slope >= CONTOUR_MIN_GRADIENT);
+	if (!contour_status.valid)
+	{
+		return false;
+	}
+
+	float north = 0.0f;
+	float east = 0.0f;
+	Contour_Position(&north, &east);
+
+	contour_status.depth_cm = contour_history.mean_depth
+		+ (gn * (north - contour_history.mean_north)) + (ge * (east - contour_history.mean_east));
+
+	float offset = (contour_status.depth_cm - contour_history.target_depth_cm) / slope;
+	if (offset > CONTOUR_MAX_OFFSET_M)
+	{
+		offset = CONTOUR_MAX_OFFSET_M;
+	}
+	else if (offset < -CONTOUR_MAX_OFFSET_M)
+	{
+		offset = -CONTOUR_MAX_OFFSET_M;
+	}
+	contour_status.cross_track_m = offset;
+
+	// Along the isobath with the shallow side (-gradient) on the right
+	float along_n = -ge / slope;
+	float along_e = gn / slope;
+
+	// No side given: the way along the isobath nearer the heading
+	if ((contour_status.shore_side != LEFT) && (contour_status.shore_side != RIGHT))
+	{
+		float th = (float)GPS_Data.rotation.E * GPS_DEG_TO_RAD;
+		contour_status.shore_side = (((along_n * cosf(th)) + (along_e * sinf(th))) >= 0.0f) ? RIGHT : LEFT;
+	}
+
+	// Too deep: turn towards the shore, clockwise for a shore on the right
+	float turn_deg = atanf(offset / CONTOUR_LOOKAHEAD_M) * CONTOUR_RAD_TO_DEG;
+	if (contour_status.shore_side == LEFT)
+	{
+		along_n = -along_n;
+		along_e = -along_e;
+		turn_deg = -turn_deg;
+	}
+
+	float course = (atan2f(along_e, along_n) * CONTOUR_RAD_TO_DEG) + turn_deg;
+	if (course < 0.0f)
+	{
+		course += 360.0f;
+	}
+	else if (course >= 360.0f)
+	{
+		course -= 360.0f;
+	}
+
+	contour_status.course_deg = course;
+	*course_deg = course;
+	return true;
+}
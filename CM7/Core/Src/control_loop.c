@@ -0,0 +1,177 @@
+/*
+ * control_loop.c
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include "control_loop.h"
+
+#include <string.h>
+
+#include "main.h"
+#include "tim.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+// A step that has not been woken for this long runs anyway, so the motors
+// keep being updated if the timer ever stops.
+#define CONTROL_LOOP_WAIT_TIMEOUT_MS  ((2U * CONTROL_LOOP_PERIOD_US) / 1000U)
+
+ControlLoopStats control_loop_stats;
+
+static TaskHandle_t control_loop_task;
+static volatile uint32_t control_loop_tick_cycles;
+static uint32_t control_loop_step_cycles;
+static uint32_t control_loop_prev_step_cycles;
+static bool control_loop_have_prev;
+static uint32_t control_loop_cycles_per_us;
+
+static uint32_t ControlLoop_CyclesToUs(uint32_t cycles)
+{
+	return cycles / control_loop_cycles_per_us;
+}
+
+void ControlLoop_ResetStats(void)
+{
+	memset(&control_loop_stats, 0, sizeof(control_loop_stats));
+	control_loop_stats.period_min_us = UINT32_MAX;
+	control_loop_stats.exec_min_us = UINT32_MAX;
+	control_loop_have_prev = false;
+}
+
+void ControlLoop_Start(void)
+{
+	control_loop_cycles_per_us = SystemCoreClock / 1000000U;
+	if (control_loop_cycles_per_us == 0U)
+	{
+		control_loop_cycles_per_us = 1U;
+	}
+
+	// DWT cycle counter for the timing statistics
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0U;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	ControlLoop_ResetStats();
+
+	control_loop_task = xTaskGetCurrentTaskHandle();
+
+	__HAL_TIM_SET_COUNTER(&htim7, 0U);
+	HAL_TIM_Base_Start_IT(&htim7);
+}
+
+void ControlLoop_WaitForTick(void)
+{
+	uint32_t ticks = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONTROL_LOOP_WAIT_TIMEOUT_MS));
+	uint32_t now = DWT->CYCCNT;
+
+	if (ticks > 1U)
+	{
+		control_loop_stats.missed_ticks += ticks - 1U;
+	}
+
+	if (ticks > 0U)
+	{
+		uint32_t latency_us = ControlLoop_CyclesToUs(now - control_loop_tick_cycles);
+		if (latency_us > control_loop_stats.wake_latency_max_us)
+		{
+			control_loop_stats.wake_latency_max_us = latency_us;
+		}
+	}
+
+	if (control_loop_have_prev)
+	{
+		uint32_t period_us = ControlLoop_CyclesToUs(now - control_loop_prev_step_cycles);
+		uint32_t jitter_us = (period_us > CONTROL_LOOP_PERIOD_US)
+			? (period_us - CONTROL_LOOP_PERIOD_US)
+			: (CONTROL_LOOP_PERIOD_US - period_us);
+
+		if (period_us < control_loop_stats.period_min_us)
+		{
+			control_loop_stats.period_min_us = period_us;
+		}
+		if (period_us > control_loop_stats.period_max_us)
+		{
+			control_loop_stats.period_max_us = period_us;
+		}
+		if (jitter_us > control_loop_stats.jitter_max_us)
+		{
+			control_loop_stats.jitter_max_us = jitter_us;
+		}
+	}
+
+	control_loop_prev_step_cycles = now;
+	control_loop_have_prev = true;
+	control_loop_step_cycles = now;
+}
+
+void ControlLoop_EndStep(void)
+{
+	uint32_t exec_us = ControlLoop_CyclesToUs(DWT->CYCCNT - control_loop_step_cycles);
+	uint32_t bin = exec_us / CONTROL_LOOP_HIST_BIN_US;
+
+	if (bin >= CONTROL_LOOP_HIST_BINS)
+	{
+		bin = CONTROL_LOOP_HIST_BINS - 1U;
+	}
+
+	control_loop_stats.steps++;
+	control_loop_stats.exec_last_us = exec_us;
+	control_loop_stats.exec_hist[bin]++;
+
+	if (exec_us < control_loop_stats.exec_min_us)
+	{
+		control_loop_stats.exec_min_us = exec_us;
+	}
+	if (exec_us > control_loop_stats.exec_max_us)
+	{
+		control_loop_stats.exec_max_us = exec_us;
+	}
+	if (exec_us > CONTROL_LOOP_PERIOD_US)
+	{
+		control_loop_stats.overruns++;
+	}
+}
+
+uint32_t ControlLoop_ExecPercentileUs(uint8_t pct)
+{
+	uint32_t total = 0U;
+
+	for (uint32_t i = 0U; i < CONTROL_LOOP_HIST_BINS; i++)
+	{
+		total += control_loop_stats.exec_hist[i];
+	}
+
+	if (total == 0U)
+	{
+		return 0U;
+	}
+
+	uint32_t target = ((total * pct) + 99U) / 100U;
+	uint32_t count = 0U;
+
+	for (uint32_t i = 0U; i < CONTROL_LOOP_HIST_BINS; i++)
+	{
+		count += control_loop_stats.exec_hist[i];
+		if (count >= target)
+		{
+			// Upper edge of the bin
+			return (i + 1U) * CONTROL_LOOP_HIST_BIN_US;
+		}
+	}
+
+	return CONTROL_LOOP_HIST_BINS * CONTROL_LOOP_HIST_BIN_US;
+}
+
+void ControlLoop_TimerISR(void)
+{
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+	control_loop_tick_cycles = DWT->CYCCNT;
+
+	if (control_loop_task != NULL)
+	{
+		vTaskNotifyGiveFromISR(control_loop_task, &xHigherPriorityTaskWoken);
+		portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+	}
+}
@@ -0,0 +1,167 @@
+/*
+ * drift.c
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include "drift.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "control_loop.h"
+#include "gps.h"
+
+// Hull model: speed reached at full thrust per axis, acceleration per unit
+// of thrust, and yaw as mass with linear drag (about 40 deg/s at full).
+#define DRIFT_SURGE_FULL_MPS     1.8f
+#define DRIFT_SWAY_FULL_MPS      0.9f
+#define DRIFT_SURGE_ACCEL_MPS2   0.9f
+#define DRIFT_SWAY_ACCEL_MPS2    0.6f
+#define DRIFT_YAW_ACCEL_DPS2     60.0f
+#define DRIFT_YAW_DRAG_PER_S     1.5f
+
+// Observer bandwidths, rad/s. Low: GNSS velocity is slow and noisy, and
+// only the steady part is wanted.
+#define DRIFT_VELOCITY_W         0.5f
+#define DRIFT_HEADING_W          1.0f
+
+DriftEstimate drift_estimate;
+
+static float Drift_Drag(float speed, float full_speed)
+{
+	float ratio = speed / full_speed;
+	return (ratio >= 0.0f) ? (ratio * ratio) : -(ratio * ratio);
+}
+
+static float Drift_WrapHeading(float heading_deg)
+{
+	while (heading_deg >= 360.0f)
+	{
+		heading_deg -= 360.0f;
+	}
+	while (heading_deg < 0.0f)
+	{
+		heading_deg += 360.0f;
+	}
+	return heading_deg;
+}
+
+static void Drift_Restart(float heading_deg)
+{
+	drift_estimate.velocity_north = (float)GPS_Data.velocity.N;
+	drift_estimate.velocity_east = (float)GPS_Data.velocity.E;
+	drift_estimate.heading_deg = heading_deg;
+	drift_estimate.yaw_rate_dps = 0.0f;
+	drift_estimate.running = true;
+}
+
+void Drift_Update(const ThrustWrench *applied)
+{
+	float heading_deg = (float)GPS_Data.rotation.E;
+
+	// Nothing to compare against: keep the disturbance, restart the rest
+	if (applied == NULL)
+	{
+		drift_estimate.running = false;
+		return;
+	}
+	if (!drift_estimate.running)
+	{
+		Drift_Restart(heading_deg);
+	}
+
+	float th = drift_estimate.heading_deg * GPS_DEG_TO_RAD;
+	float c = cosf(th);
+	float s = sinf(th);
+
+	// Translation, in the body frame for the model
+	float forward = (drift_estimate.velocity_north * c) + (drift_estimate.velocity_east * s);
+	float right = (-drift_estimate.velocity_north * s) + (drift_estimate.velocity_east * c);
+	float dist_forward = (drift_estimate.north * c) + (drift_estimate.east * s);
+	float dist_right = (-drift_estimate.north * s) + (drift_estimate.east * c);
+	float accel_forward = DRIFT_SURGE_ACCEL_MPS2
+		* (applied->surge + dist_forward - Drift_Drag(forward, DRIFT_SURGE_FULL_MPS));
+	float accel_right = DRIFT_SWAY_ACCEL_MPS2
+		* (applied->sway + dist_right - Drift_Drag(right, DRIFT_SWAY_FULL_MPS));
+	float accel_north = (accel_forward * c) - (accel_right * s);
+	float accel_east = (accel_forward * s) + (accel_right * c);
+
+	float err_north = (float)GPS_Data.velocity.N - drift_estimate.velocity_north;
+	float err_east = (float)GPS_Data.velocity.E - drift_estimate.velocity_east;
+	// Error poles at -DRIFT_VELOCITY_W (twice), taking a mean acceleration
+	// per unit of thrust for the disturbance gain
+	float l_velocity = 2.0f * DRIFT_VELOCITY_W;
+	float l_disturbance = (DRIFT_VELOCITY_W * DRIFT_VELOCITY_W)
+		/ (0.5f * (DRIFT_SURGE_ACCEL_MPS2 + DRIFT_SWAY_ACCEL_MPS2));
+
+	drift_estimate.velocity_north += CONTROL_LOOP_DT_S * (accel_north + (l_velocity * err_north));
+	drift_estimate.velocity_east += CONTROL_LOOP_DT_S * (accel_east + (l_velocity * err_east));
+	drift_estimate.north += CONTROL_LOOP_DT_S * l_disturbance * err_north;
+	drift_estimate.east += CONTROL_LOOP_DT_S * l_disturbance * err_east;
+
+	// Yaw, driven by heading: error poles at -DRIFT_HEADING_W (three times)
+	float err_heading = heading_deg - drift_estimate.heading_deg;
+	if (err_heading > 180.0f)
+	{
+		err_heading -= 360.0f;
+	}
+	else if (err_heading < -180.0f)
+	{
+		err_heading += 360.0f;
+	}
+	float l1 = (3.0f * DRIFT_HEADING_W) - DRIFT_YAW_DRAG_PER_S;
+	float l2 = (3.0f * DRIFT_HEADING_W * DRIFT_HEADING_W) - (DRIFT_YAW_DRAG_PER_S * l1);
+	float l3 = (DRIFT_HEADING_W * DRIFT_HEADING_W * DRIFT_HEADING_W) / DRIFT_YAW_ACCEL_DPS2;
+	float yaw_accel = (DRIFT_YAW_ACCEL_DPS2 * (applied->yaw + drift_estimate.yaw))
+		- (DRIFT_YAW_DRAG_PER_S * drift_estimate.yaw_rate_dps);
+
+	drift_estimate.heading_deg = Drift_WrapHeading(drift_estimate.heading_deg
+		+ (CONTROL_LOOP_DT_S * (drift_estimate.yaw_rate_dps + (l1 * err_heading))));
+	drift_estimate.yaw_rate_dps += CONTROL_LOOP_DT_S * (yaw_accel + (l2 * err_heading));
+	drift_estimate.yaw += CONTROL_LOOP_DT_S * l3 * err_heading;
+
+	if (drift_estimate.settled_s < DRIFT_SETTLE_S)
+	{
+		drift_estimate.settled_s += CONTROL_LOOP_DT_S;
+	}
+}
+
+void Drift_BodyWrench(float heading_deg, ThrustWrench *disturbance)
+{
+	memset(disturbance, 0, sizeof(*disturbance));
+
+	if (drift_estimate.settled_s < DRIFT_SETTLE_S)
+	{
+		return;
+	}
+
+	float th = heading_deg * GPS_DEG_TO_RAD;
+	float c = cosf(th);
+	float s = sinf(th);
+
+	disturbance->surge = (drift_estimate.north * c) + (drift_estimate.east * s);
+	disturbance->sway = (-drift_estimate.north * s) + (drift_estimate.east * c);
+	disturbance->yaw = drift_estimate.yaw;
+}
+
+void Drift_FreeVelocity(float *velocity_north, float *velocity_east)
+{
+	ThrustWrench body;
+	float heading_deg = (float)GPS_Data.rotation.E;
+
+	Drift_BodyWrench(heading_deg, &body);
+
+	// Drag balances the disturbance: (v / v_full)^2 = thrust per axis
+	float forward = DRIFT_SURGE_FULL_MPS * sqrtf(fabsf(body.surge));
+	float right = DRIFT_SWAY_FULL_MPS * sqrtf(fabsf(body.sway));
+	forward = (body.surge >= 0.0f) ? forward : -forward;
+	right = (body.sway >= 0.0f) ? right : -right;
+
+	float th = heading_deg * GPS_DEG_TO_RAD;
+	float c = cosf(th);
+	float s = sinf(th);
+
+	*velocity_north = (forward * c) - (right * s);
+	*velocity_east = (forward * s) + (right * c);
+}
@@ -35,6 +35,12 @@
 #include "queue.h"
 #include "motor_control.h"
 #include "radar.h"
+#include "control_loop.h"
+#include "thrust_cal.h"
+#include "waypoint.h"
+#include "loiter.h"
+#include "obstacle.h"
+#include "contour.h"
 #include "usbd_def.h"
 #include <math.h>
 /* USER CODE END Includes */
@@ -46,8 +52,6 @@
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
-#define MOTOR_LOOP_DELAY_MS              100
-
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -70,8 +74,8 @@ const osThreadAttr_t SonarTask_attributes = {
 osThreadId_t MotorControlTasHandle;
 const osThreadAttr_t MotorControlTas_attributes = {
   .name = "MotorControlTas",
-  .stack_size = 128 * 4,
-  .priority = (osPriority_t) osPriorityLow,
+  .stack_size = 512 * 4,
+  .priority = (osPriority_t) osPriorityHigh,
 };
 /* Definitions for DetermineStateT */
 osThreadId_t DetermineStateTHandle;
@@ -253,16 +257,23 @@ void StartMotorControlTask(void *argument)
 
   MotorControlState motor_state;
   MotorControl_InitState(&motor_state);
+  ThrustCal_Init();
 
   HAL_TIM_PWM_Start(&htim2, TIM_CHANNEL_1); // 45 degree
   HAL_TIM_PWM_Start(&htim2, TIM_CHANNEL_2); // 135 degree
   HAL_TIM_PWM_Start(&htim2, TIM_CHANNEL_3); // 225 degree
   HAL_TIM_PWM_Start(&htim2, TIM_CHANNEL_4); // 315 degree
 
+  // Steps are paced by TIM7 at CONTROL_LOOP_RATE_HZ
+  ControlLoop_Start();
+
   /* Infinite loop */
   for(;;)
   {
+    ControlLoop_WaitForTick();
+
     bool got_ui_update = false;
+    bool got_sonar_update = false;
 
     if (xQueueReceive((QueueHandle_t)UIQueueHandle, &latest_ui, 0) == pdPASS)
     {
@@ -272,10 +283,19 @@ void StartMotorControlTask(void *argument)
     if (xQueueReceive((QueueHandle_t)sonarQueueHandle, &latest_sonar, 0) == pdPASS)
     {
       sonar_data_valid = true;
+      got_sonar_update = true;
     }
 
     if ((operatingMode_t)latest_ui.mode != current_mode)
     {
+      if (current_mode == MODE_LOITER)
+      {
+        Loiter_Stop();
+      }
+      else if (current_mode == MODE_FOLLOW_SHORE)
+      {
+        Contour_Stop();
+      }
       current_mode = (operatingMode_t)latest_ui.mode;
       mode_entry = true;
     }
@@ -286,6 +306,10 @@ void StartMotorControlTask(void *argument)
 
     motor_speed motor_cmd = {0};
 
+    MotorControl_UpdateDrift(current_mode);
+    MotorControl_UpdateGeofence(current_mode);
+    Obstacle_Update();
+
     switch (current_mode)
     {
       case MODE_DISABLE:
@@ -308,6 +332,7 @@ void StartMotorControlTask(void *argument)
         break;
 
       case MODE_MOVE:
+      case MODE_CRUISE:
         HAL_GPIO_WritePin(GPIOD, GPIO_PIN_11, GPIO_PIN_SET); // Motor relay on
         MotorControl_ModeMove(&motor_state, mode_entry, got_ui_update, &latest_ui,
                               sonar_data_valid, &latest_sonar,
@@ -316,8 +341,10 @@ void StartMotorControlTask(void *argument)
         break;
 
       case MODE_ANCHOR:
+      case MODE_ANCHOR_WEATHERVANE:
         HAL_GPIO_WritePin(GPIOD, GPIO_PIN_11, GPIO_PIN_SET); // Motor relay on
         MotorControl_ModeAnchor(&motor_state, mode_entry,
+                                (current_mode == MODE_ANCHOR_WEATHERVANE),
                                 &motor_cmd,
                                 &mode_entry);
         break;
@@ -325,7 +352,7 @@ void StartMotorControlTask(void *argument)
       case MODE_FOLLOW_SHORE:
         HAL_GPIO_WritePin(GPIOD, GPIO_PIN_11, GPIO_PIN_SET); // Motor relay on
         MotorControl_ModeFollowShore(&motor_state, mode_entry, got_ui_update, &latest_ui,
-                                     sonar_data_valid, &latest_sonar,
+                                     sonar_data_valid, got_sonar_update, &latest_sonar,
                                      &motor_cmd,
                                      &mode_entry);
         break;
@@ -334,6 +361,24 @@ void StartMotorControlTask(void *argument)
         MotorControl_ModeOverride(&latest_ui,
                                   &motor_cmd);
         break;
+      case MODE_WAYPOINT:
+        HAL_GPIO_WritePin(GPIOD, GPIO_PIN_11, GPIO_PIN_SET); // Motor relay on
+        MotorControl_ModeWaypoint(&motor_state, mode_entry, &latest_ui,
+                                  &motor_cmd,
+                                  &mode_entry);
+        break;
+      case MODE_LOITER:
+        HAL_GPIO_WritePin(GPIOD, GPIO_PIN_11, GPIO_PIN_SET); // Motor relay on
+        MotorControl_ModeLoiter(mode_entry, &latest_ui,
+                                &motor_cmd,
+                                &mode_entry);
+        break;
+      case MOTOR_CALIBRATE:
+        HAL_GPIO_WritePin(GPIOD, GPIO_PIN_11, GPIO_PIN_SET); // Motor relay on
+        MotorControl_ModeCalibrate(mode_entry,
+                                   &motor_cmd,
+                                   &mode_entry);
+        break;
       default:
         current_mode = MODE_DISABLE;
         mode_entry = true;
@@ -347,7 +392,7 @@ void StartMotorControlTask(void *argument)
 
       MotorControl_SetOutputs(&motor_cmd);
 
-    osDelay(MOTOR_LOOP_DELAY_MS);
+    ControlLoop_EndStep();
   }
   /* USER CODE END StartMotorControlTask */
 }
@@ -424,6 +469,9 @@ void StartGPSTask(void *argument)
       // Decode position/velocity
       decode_nav(&GPS_Parsed_Data, &GPS_Data);
 
+      // Route progress to the ESP32; the line is free again before the GPS frame below
+      Waypoint_TxTelemetry();
+
       uart4_status = HAL_UART_Transmit_DMA(&huart4, ubx_tx_poll_att, sizeof(ubx_tx_poll_att));
       if(uart4_status == HAL_ERROR || uart4_status == HAL_TIMEOUT) { continue; } // Bail
 
@@ -436,9 +484,8 @@ void StartGPSTask(void *argument)
       // Decode rotation using latest ATT fields
       decode_nav(&GPS_Parsed_Data, &GPS_Data);
 
-      if (usart6_tx_complete)
+      if (USART6_ClaimTx())
       {
-        usart6_tx_complete = false;
         GPS_PopulateESP32Buffer(&GPS_Data, UART6_txBuffer);
         SCB_CleanDCache_by_Addr((uint32_t *)UART6_txBuffer, UART4_DMA_CACHE_ALIGN_UP(ESP32_GPS_TX_LEN));
 
@@ -450,6 +497,9 @@ void StartGPSTask(void *argument)
 
 			while((current_ticks - ticks) < poll_time) { current_ticks = xTaskGetTickCount(); }
 
+      // Loiter status; the GPS frame above has gone by now
+      Loiter_TxTelemetry();
+
   }
   /* USER CODE END StartGPSTask */
 }
@@ -474,7 +524,13 @@ void StartRadarTask(void *argument)
 
 	  usb_radar_tx_state();
 
-	  osDelay(200);
+	  // Let the state line leave the CDC endpoint before the next one.
+	  osDelay(5);
+
+	  usb_radar_tx_param();
+	  usart6_radar_tx_param_reply();
+
+	  osDelay(195);
 
 
   }
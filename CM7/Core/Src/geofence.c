@@ -0,0 +1,284 @@
+/*
+ * geofence.c
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include "geofence.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "gps.h"
+#include "stm32h7xx_hal.h"
+
+// Repulsion starts this far inside the safe side of a boundary
+#define GEOFENCE_MARGIN_M        10.0f
+
+// Fence being uploaded, filled from the USART6 interrupt
+typedef struct
+{
+	uint8_t polygon_count;
+	uint8_t type[GEOFENCE_MAX_POLYGONS];
+	uint8_t vertex_count[GEOFENCE_MAX_POLYGONS];
+	int32_t lat_e7[GEOFENCE_MAX_POLYGONS][GEOFENCE_MAX_VERTICES];
+	int32_t lon_e7[GEOFENCE_MAX_POLYGONS][GEOFENCE_MAX_VERTICES];
+	uint16_t lat_mask[GEOFENCE_MAX_POLYGONS];
+	uint16_t lon_mask[GEOFENCE_MAX_POLYGONS];
+	bool ready;
+} GeofenceUpload;
+
+Geofence geofence;
+uint32_t geofence_query_cycles_max;
+
+static GeofenceUpload geofence_upload;
+
+void Geofence_RxFrame(const uint8_t frame[8])
+{
+	uint8_t op = frame[1];
+	uint8_t arg = frame[2];
+	uint8_t poly = arg / GEOFENCE_MAX_VERTICES;
+	uint8_t vertex = arg % GEOFENCE_MAX_VERTICES;
+	int32_t value;
+
+	memcpy(&value, &frame[3], 4);
+
+	if (op == GEOFENCE_OP_BEGIN)
+	{
+		memset(&geofence_upload, 0, sizeof(geofence_upload));
+		geofence_upload.polygon_count = (arg <= GEOFENCE_MAX_POLYGONS) ? arg : 0U;
+	}
+	else if ((op == GEOFENCE_OP_POLYGON) && (arg < geofence_upload.polygon_count))
+	{
+		geofence_upload.type[arg] = frame[3];
+		geofence_upload.vertex_count[arg] = (frame[4] <= GEOFENCE_MAX_VERTICES) ? frame[4] : 0U;
+	}
+	else if ((op == GEOFENCE_OP_LAT) && (poly < geofence_upload.polygon_count))
+	{
+		geofence_upload.lat_e7[poly][vertex] = value;
+		geofence_upload.lat_mask[poly] |= (uint16_t)(1U << vertex);
+	}
+	else if ((op == GEOFENCE_OP_LON) && (poly < geofence_upload.polygon_count))
+	{
+		geofence_upload.lon_e7[poly][vertex] = value;
+		geofence_upload.lon_mask[poly] |= (uint16_t)(1U << vertex);
+	}
+	else if ((op == GEOFENCE_OP_COMMIT) && (arg == geofence_upload.polygon_count))
+	{
+		bool complete = true;
+
+		for (uint8_t p = 0U; p < geofence_upload.polygon_count; p++)
+		{
+			uint8_t n = geofence_upload.vertex_count[p];
+			uint16_t full = (uint16_t)((1UL << n) - 1UL);
+
+			if ((n < 3U) || (geofence_upload.lat_mask[p] != full) || (geofence_upload.lon_mask[p] != full))
+			{
+				complete = false;
+			}
+		}
+		geofence_upload.ready = complete;
+	}
+}
+
+static void Geofence_Precompute(GeofencePolygon *poly)
+{
+	uint8_t n = poly->vertex_count;
+
+	poly->min_x = poly->x[0];
+	poly->max_x = poly->x[0];
+	poly->min_y = poly->y[0];
+	poly->max_y = poly->y[0];
+
+	for (uint8_t i = 0U; i < n; i++)
+	{
+		uint8_t j = ((i + 1U) < n) ? (i + 1U) : 0U;
+		float len2;
+
+		poly->dx[i] = poly->x[j] - poly->x[i];
+		poly->dy[i] = poly->y[j] - poly->y[i];
+		len2 = (poly->dx[i] * poly->dx[i]) + (poly->dy[i] * poly->dy[i]);
+		poly->inv_len2[i] = (len2 > 0.0f) ? (1.0f / len2) : 0.0f;
+		poly->x_per_y[i] = (poly->dy[i] != 0.0f) ? (poly->dx[i] / poly->dy[i]) : 0.0f;
+
+		if (poly->x[i] < poly->min_x) { poly->min_x = poly->x[i]; }
+		if (poly->x[i] > poly->max_x) { poly->max_x = poly->x[i]; }
+		if (poly->y[i] < poly->min_y) { poly->min_y = poly->y[i]; }
+		if (poly->y[i] > poly->max_y) { poly->max_y = poly->y[i]; }
+	}
+}
+
+void Geofence_Poll(void)
+{
+	static GeofenceUpload pending;
+	bool ready = false;
+
+	taskENTER_CRITICAL();
+	if (geofence_upload.ready)
+	{
+		memcpy(&pending, &geofence_upload, sizeof(pending));
+		geofence_upload.ready = false;
+		ready = true;
+	}
+	taskEXIT_CRITICAL();
+
+	if (!ready)
+	{
+		return;
+	}
+
+	static Geofence fence;
+	memset(&fence, 0, sizeof(fence));
+
+	if (pending.polygon_count > 0U)
+	{
+		fence.origin_lat = (double)pending.lat_e7[0][0] * 1e-7;
+		fence.origin_lon = (double)pending.lon_e7[0][0] * 1e-7;
+	}
+
+	for (uint8_t p = 0U; p < pending.polygon_count; p++)
+	{
+		GeofencePolygon *poly = &fence.polygons[p];
+
+		poly->type = (pending.type[p] == GEOFENCE_KEEP_OUT) ? GEOFENCE_KEEP_OUT : GEOFENCE_KEEP_IN;
+		poly->vertex_count = pending.vertex_count[p];
+
+		for (uint8_t v = 0U; v < poly->vertex_count; v++)
+		{
+			GPS_CalculateOffsetMeters(fence.origin_lat, fence.origin_lon,
+									  (double)pending.lat_e7[p][v] * 1e-7, (double)pending.lon_e7[p][v] * 1e-7,
+									  &poly->y[v], &poly->x[v]);
+		}
+		Geofence_Precompute(poly);
+	}
+	fence.polygon_count = pending.polygon_count;
+
+	// The control task is the only reader, so no lock is needed here.
+	memcpy(&geofence, &fence, sizeof(geofence));
+	geofence_query_cycles_max = 0U;
+}
+
+/*
+ * Distance from (px, py) to the polygon boundary, the nearest boundary
+ * point, and whether the point is inside (crossing number), in one pass
+ * over the edges.
+ */
+static float Geofence_PolygonDistance(const GeofencePolygon *poly, float px, float py,
+									  float *qx, float *qy, bool *inside)
+{
+	float best_d2 = INFINITY;
+	bool in = false;
+
+	for (uint8_t i = 0U; i < poly->vertex_count; i++)
+	{
+		float ax = poly->x[i];
+		float ay = poly->y[i];
+		float dx = poly->dx[i];
+		float dy = poly->dy[i];
+		float t = (((px - ax) * dx) + ((py - ay) * dy)) * poly->inv_len2[i];
+
+		if (t < 0.0f)
+		{
+			t = 0.0f;
+		}
+		else if (t > 1.0f)
+		{
+			t = 1.0f;
+		}
+
+		float cx = ax + (t * dx);
+		float cy = ay + (t * dy);
+		float d2 = ((px - cx) * (px - cx)) + ((py - cy) * (py - cy));
+
+		if (d2 < best_d2)
+		{
+			best_d2 = d2;
+			*qx = cx;
+			*qy = cy;
+		}
+
+		// Crossing test on a ray towards +x
+		float by = ay + dy;
+		if (((ay > py) != (by > py)) && (px < (ax + (poly->x_per_y[i] * (py - ay)))))
+		{
+			in = !in;
+		}
+	}
+
+	*inside = in;
+	return sqrtf(best_d2);
+}
+
+bool Geofence_Query(double latitude, double longitude, GeofenceResult *result)
+{
+	uint32_t start = DWT->CYCCNT;
+	float north = 0.0f;
+	float east = 0.0f;
+	bool found = false;
+
+	memset(result, 0, sizeof(*result));
+
+	if (geofence.polygon_count == 0U)
+	{
+		return false;
+	}
+
+	GPS_CalculateOffsetMeters(geofence.origin_lat, geofence.origin_lon, latitude, longitude, &north, &east);
+
+	for (uint8_t p = 0U; p < geofence.polygon_count; p++)
+	{
+		const GeofencePolygon *poly = &geofence.polygons[p];
+
+		// A keep-out polygon farther than the margin cannot matter
+		if ((poly->type == GEOFENCE_KEEP_OUT)
+			&& ((east < (poly->min_x - GEOFENCE_MARGIN_M)) || (east > (poly->max_x + GEOFENCE_MARGIN_M))
+				|| (north < (poly->min_y - GEOFENCE_MARGIN_M)) || (north > (poly->max_y + GEOFENCE_MARGIN_M))))
+		{
+			continue;
+		}
+
+		float qx = east;
+		float qy = north;
+		bool inside = false;
+		float d = Geofence_PolygonDistance(poly, east, north, &qx, &qy, &inside);
+		bool safe = (inside == (poly->type == GEOFENCE_KEEP_IN));
+		float margin = safe ? d : -d;
+
+		if (!found || (margin < result->margin_m))
+		{
+			// Away from the boundary on the safe side, towards it otherwise
+			float vx = safe ? (east - qx) : (qx - east);
+			float vy = safe ? (north - qy) : (qy - north);
+			float len = sqrtf((vx * vx) + (vy * vy));
+
+			found = true;
+			result->margin_m = margin;
+			result->violation = !safe;
+			result->push_east = (len > 1e-3f) ? (vx / len) : 0.0f;
+			result->push_north = (len > 1e-3f) ? (vy / len) : 0.0f;
+		}
+	}
+
+	if (found)
+	{
+		if (result->violation)
+		{
+			result->strength = 1.0f;
+		}
+		else if (result->margin_m < GEOFENCE_MARGIN_M)
+		{
+			float s = (GEOFENCE_MARGIN_M - result->margin_m) / GEOFENCE_MARGIN_M;
+			result->strength = s * s;
+		}
+	}
+
+	uint32_t cycles = DWT->CYCCNT - start;
+	if (cycles > geofence_query_cycles_max)
+	{
+		geofence_query_cycles_max = cycles;
+	}
+
+	return true;
+}
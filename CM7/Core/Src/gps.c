@@ -15,6 +15,7 @@
 
 
 #include "gps.h"
+#include <math.h>
 #include <string.h>
 
 #define GPS_POSITION_AVG_WINDOW 5U
@@ -98,6 +99,7 @@ void decode_nav(GPSParsedDataStruct *gpds, GPSDataStruct *gds)
 	gds->velocity.N = vel[0];
 	gds->velocity.E = vel[1];
 	gds->velocity.D = vel[2];
+	gds->ground_speed = (double)gpds->gSpeed * 1e-3;
 	gds->rotation.N = rot[0];
 	gds->rotation.E = rot[1];
 	gds->rotation.D = rot[2];
@@ -152,4 +154,16 @@ void GPS_PopulateESP32Buffer(GPSDataStruct *gps, uint8_t buf[85])
 
     // device_id
     memcpy(p, gps->device_id, 5); p += 5;
-}
\ No newline at end of file
+}
+
+void GPS_CalculateOffsetMeters(double desired_lat, double desired_lon,
+							   double current_lat, double current_lon,
+							   float *north_m, float *east_m)
+{
+	// Flat-earth approximation for local offsets.
+	float lat_rad = (float)desired_lat * GPS_DEG_TO_RAD;
+	float meters_per_deg_lon = GPS_METERS_PER_DEG_LAT * cosf(lat_rad);
+
+	*north_m = (float)((current_lat - desired_lat) * GPS_METERS_PER_DEG_LAT);
+	*east_m = (float)((current_lon - desired_lon) * meters_per_deg_lon);
+}
@@ -0,0 +1,258 @@
+/*
+ * loiter.c
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include "loiter.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "control_loop.h"
+#include "drift.h"
+#include "gps.h"
+#include "usart.h"
+
+// Pulse when drifting would leave the circle within this time: long enough
+// to stop the drift and turn it round.
+#define LOITER_EXIT_LEAD_S         8.0f
+// Pulse aim: this far across the circle on the upstream side of the centre
+#define LOITER_UPSTREAM_FRACTION   0.7f
+// The pulse ends this close to the aim point, or after LOITER_PULSE_MAX_S
+#define LOITER_AIM_TOLERANCE_M     1.5f
+#define LOITER_PULSE_MAX_S         30.0f
+// Pulse thrust candidates, LOITER_PULSE_MIN_THRUST up to
+// LOITER_PULSE_MAX_THRUST in LOITER_PULSE_THRUST_STEP
+#define LOITER_PULSE_MIN_THRUST    0.1f
+#define LOITER_PULSE_MAX_THRUST    0.5f
+#define LOITER_PULSE_THRUST_STEP   0.05f
+// Water speed at full thrust (cruise model) for the pulse choice
+#define LOITER_FULL_THRUST_MPS     1.8f
+// Drift slower than this has no useful direction; aim for the centre
+#define LOITER_MIN_DRIFT_MPS       0.05f
+// Drift prediction: how far ahead, in steps of, and how quickly the boat
+// settles to the free drift velocity once the motors stop
+#define LOITER_PREDICT_S           60.0f
+#define LOITER_PREDICT_STEP_S      1.0f
+#define LOITER_SETTLE_TAU_S        2.0f
+
+LoiterStatus loiter_status;
+
+static uint8_t loiter_tx_buffer[32] __attribute__((aligned(32)));
+
+void Loiter_Start(double latitude, double longitude, float radius_m)
+{
+	if (radius_m < LOITER_MIN_RADIUS_M)
+	{
+		radius_m = LOITER_MIN_RADIUS_M;
+	}
+	else if (radius_m > LOITER_MAX_RADIUS_M)
+	{
+		radius_m = LOITER_MAX_RADIUS_M;
+	}
+
+	// A UI update while loitering only changes the radius
+	if (loiter_status.state == LOITER_OFF)
+	{
+		memset(&loiter_status, 0, sizeof(loiter_status));
+		loiter_status.centre_lat = latitude;
+		loiter_status.centre_lon = longitude;
+		loiter_status.state = LOITER_DRIFTING;
+	}
+	loiter_status.radius_m = radius_m;
+}
+
+void Loiter_Stop(void)
+{
+	loiter_status.state = LOITER_OFF;
+}
+
+/*
+ * Time until drifting with the motors off leaves a circle of radius r, up
+ * to LOITER_PREDICT_S: the velocity v settles to the free drift velocity vd
+ * with time constant LOITER_SETTLE_TAU_S.
+ */
+static float Loiter_ExitTime(float pn, float pe, float vn, float ve, float r)
+{
+	float vdn = 0.0f;
+	float vde = 0.0f;
+
+	if (((pn * pn) + (pe * pe)) >= (r * r))
+	{
+		return 0.0f;
+	}
+
+	Drift_FreeVelocity(&vdn, &vde);
+
+	for (uint8_t i = 1U; i <= (uint8_t)(LOITER_PREDICT_S / LOITER_PREDICT_STEP_S); i++)
+	{
+		float t = (float)i * LOITER_PREDICT_STEP_S;
+		float settle = LOITER_SETTLE_TAU_S * (1.0f - expf(-t / LOITER_SETTLE_TAU_S));
+		float n = pn + (vdn * t) + ((vn - vdn) * settle);
+		float e = pe + (vde * t) + ((ve - vde) * settle);
+
+		if (((n * n) + (e * e)) >= (r * r))
+		{
+			return t;
+		}
+	}
+	return LOITER_PREDICT_S;
+}
+
+float Loiter_MotorPowerW(float thrust)
+{
+	if (thrust <= 0.0f)
+	{
+		return 0.0f;
+	}
+	return LOITER_MOTOR_IDLE_POWER_W + (LOITER_MOTOR_FULL_POWER_W * thrust * sqrtf(thrust));
+}
+
+/*
+ * Pulse thrust with the least energy per metre made good against a drift
+ * of drift_mps. A thrust of T on one axis runs a pair of motors at T and
+ * moves the boat through the water at LOITER_FULL_THRUST_MPS * sqrt(T).
+ */
+static float Loiter_PulseThrust(float drift_mps)
+{
+	float best_thrust = LOITER_PULSE_MAX_THRUST;
+	float best_cost = INFINITY;
+
+	uint8_t steps = (uint8_t)(((LOITER_PULSE_MAX_THRUST - LOITER_PULSE_MIN_THRUST) / LOITER_PULSE_THRUST_STEP) + 0.5f);
+
+	for (uint8_t i = 0U; i <= steps; i++)
+	{
+		float t = LOITER_PULSE_MIN_THRUST + ((float)i * LOITER_PULSE_THRUST_STEP);
+		float gain_mps = (LOITER_FULL_THRUST_MPS * sqrtf(t)) - drift_mps;
+
+		if (gain_mps <= 0.0f)
+		{
+			continue;
+		}
+
+		float cost = (2.0f * Loiter_MotorPowerW(t)) / gain_mps;
+		if (cost < best_cost)
+		{
+			best_cost = cost;
+			best_thrust = t;
+		}
+	}
+	return best_thrust;
+}
+
+void Loiter_Update(double latitude, double longitude, float power_w,
+				   float *thrust_north, float *thrust_east)
+{
+	float pn = 0.0f;
+	float pe = 0.0f;
+
+	*thrust_north = 0.0f;
+	*thrust_east = 0.0f;
+
+	if (loiter_status.state == LOITER_OFF)
+	{
+		return;
+	}
+
+	loiter_status.elapsed_s += CONTROL_LOOP_DT_S;
+	loiter_status.energy_wh += power_w * CONTROL_LOOP_DT_S / 3600.0f;
+	if (power_w > 0.0f)
+	{
+		loiter_status.motors_on_s += CONTROL_LOOP_DT_S;
+	}
+
+	GPS_CalculateOffsetMeters(loiter_status.centre_lat, loiter_status.centre_lon,
+							  latitude, longitude, &pn, &pe);
+	loiter_status.distance_m = sqrtf((pn * pn) + (pe * pe));
+
+	float vn = drift_estimate.velocity_north;
+	float ve = drift_estimate.velocity_east;
+	loiter_status.exit_in_s = Loiter_ExitTime(pn, pe, vn, ve, loiter_status.radius_m);
+
+	// Drift from the disturbance estimate, which does not swing about
+	// during a pulse the way the velocity does
+	float free_n = 0.0f;
+	float free_e = 0.0f;
+	Drift_FreeVelocity(&free_n, &free_e);
+	float drift_mps = sqrtf((free_n * free_n) + (free_e * free_e));
+
+	float aim_n = 0.0f;
+	float aim_e = 0.0f;
+	if (drift_mps >= LOITER_MIN_DRIFT_MPS)
+	{
+		aim_n = -LOITER_UPSTREAM_FRACTION * loiter_status.radius_m * free_n / drift_mps;
+		aim_e = -LOITER_UPSTREAM_FRACTION * loiter_status.radius_m * free_e / drift_mps;
+	}
+	float to_n = aim_n - pn;
+	float to_e = aim_e - pe;
+	float to_aim = sqrtf((to_n * to_n) + (to_e * to_e));
+
+	if (loiter_status.state == LOITER_DRIFTING)
+	{
+		if (loiter_status.exit_in_s < LOITER_EXIT_LEAD_S)
+		{
+			loiter_status.state = LOITER_PULSE;
+			loiter_status.pulse_s = 0.0f;
+			loiter_status.pulses++;
+		}
+	}
+	else if ((to_aim < LOITER_AIM_TOLERANCE_M) || (loiter_status.pulse_s >= LOITER_PULSE_MAX_S))
+	{
+		loiter_status.state = LOITER_DRIFTING;
+	}
+
+	if ((loiter_status.state != LOITER_PULSE) || (to_aim < 1e-3f))
+	{
+		return;
+	}
+
+	float thrust = Loiter_PulseThrust(drift_mps);
+
+	*thrust_north = thrust * to_n / to_aim;
+	*thrust_east = thrust * to_e / to_aim;
+	loiter_status.pulse_s += CONTROL_LOOP_DT_S;
+}
+
+float Loiter_AveragePowerW(void)
+{
+	if (loiter_status.elapsed_s <= 0.0f)
+	{
+		return 0.0f;
+	}
+	return loiter_status.energy_wh * 3600.0f / loiter_status.elapsed_s;
+}
+
+void Loiter_TxTelemetry(void)
+{
+	if ((loiter_status.state == LOITER_OFF) || !USART6_ClaimTx())
+	{
+		return;
+	}
+
+	float dist_dm = loiter_status.distance_m * 10.0f;
+	float power_w = Loiter_AveragePowerW();
+	uint16_t dist = (dist_dm > 65535.0f) ? 65535U : (uint16_t)dist_dm;
+	uint16_t power = (power_w > 65535.0f) ? 65535U : (uint16_t)power_w;
+	uint8_t duty = 0U;
+	uint8_t *p = loiter_tx_buffer;
+
+	if (loiter_status.elapsed_s > 0.0f)
+	{
+		duty = (uint8_t)((100.0f * loiter_status.motors_on_s) / loiter_status.elapsed_s);
+	}
+
+	*p++ = LOITER_TELEMETRY_START;
+	*p++ = (uint8_t)loiter_status.state;
+	*p++ = (uint8_t)loiter_status.radius_m;
+	memcpy(p, &dist, 2); p += 2;
+	memcpy(p, &power, 2); p += 2;
+	*p = duty;
+
+	SCB_CleanDCache_by_Addr((uint32_t *)loiter_tx_buffer, sizeof(loiter_tx_buffer));
+
+	if (HAL_UART_Transmit_DMA(&huart6, loiter_tx_buffer, LOITER_TELEMETRY_TX_LEN) != HAL_OK)
+	{
+		usart6_tx_complete = true;
+	}
+}
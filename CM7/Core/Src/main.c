@@ -28,6 +28,7 @@
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
 #include "stdbool.h"
+#include "control_loop.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -151,6 +152,7 @@ Error_Handler();
   MX_UART5_Init();
   MX_UART4_Init();
   MX_TIM2_Init();
+  MX_TIM7_Init();
   MX_USART6_UART_Init();
   /* USER CODE BEGIN 2 */
   
@@ -256,7 +258,10 @@ void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
     HAL_IncTick();
   }
   /* USER CODE BEGIN Callback 1 */
-
+  if (htim->Instance == TIM7)
+  {
+    ControlLoop_TimerISR();
+  }
   /* USER CODE END Callback 1 */
 }
 
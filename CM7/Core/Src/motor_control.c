@@ -9,42 +9,86 @@
 
 #include <math.h>
 
+#include "anchor_mpc.h"
+#include "contour.h"
+#include "control_loop.h"
+#include "drift.h"
+#include "geofence.h"
 #include "gps.h"
+#include "loiter.h"
+#include "obstacle.h"
 #include "stm32h7xx_hal.h"
 #include "radar.h"
+#include "thrust_alloc.h"
+#include "thrust_cal.h"
 #include "tim.h"
+#include "waypoint.h"
 
 #define MOTOR_PWM_MAX_COUNTS             10000
 #define SONAR_OBSTACLE_NEAR_CM           50.0f  // distance threshold for sonar aggressive maneuver
-#define RADAR_OBSTACLE_NEAR_M            1.0f   // distance threshold for radar aggressive maneuver
 #define RADAR_EMERGENCY_MIN_M            1.5f
-#define RADAR_OBSTACLE_CAUTION_M         3.0f
 #define RADAR_EMERGENCY_REVERSE_M        3.0f   // distance threshold for radar emergency reverse in move mode
 #define RADAR_FRONT_CONE_DEG             60.0f  // ignore objects outside this forward cone
-#define RADAR_STALE_TIMEOUT_MS           2000U  // ignore radar data older than this
-#define MOTOR_TURN_SOFT_DELTA_CMD        40     // change in speed for softer maneuver
+#define RADAR_COLLISION_LOOKAHEAD_S      2.0f   // predict closing targets this far ahead
 #define MOTOR_TURN_HARD_DELTA_CMD        90     // change in speed for aggressive maneuver
+#define RADAR_AVOID_TURN_CMD_PER_DEG     1.5f   // avoidance turn per degree of heading change
 #define MOTOR_DEADBAND_MIN_ON_CMD        63U
+// Output slew limit: time for a full-scale change (0 to 255).
+#define MOTOR_SLEW_FULL_SCALE_S          0.5f
+#define MOTOR_SLEW_COUNTS_PER_STEP       ((uint32_t)(((float)MOTOR_PWM_MAX_COUNTS * CONTROL_LOOP_DT_S) / MOTOR_SLEW_FULL_SCALE_S))
 #define UI_SPEED_MAX_CMD                 100U
 
-#define ANCHOR_HEADING_ON_DEG            15.0f
-#define ANCHOR_HEADING_OFF_DEG           5.0f
-// Hysteresis: activate correction when > ANCHOR_POSITION_ON_M,
-// deactivate when < ANCHOR_POSITION_OFF_M
-#define ANCHOR_POSITION_ON_M             2.5f
-#define ANCHOR_POSITION_OFF_M            2.0f
-// Anchor correction speeds (0-100 units). Do NOT exceed 50 per request.
-#define ANCHOR_POSITION_SPEED_MAX_0_100  50U
-#define ANCHOR_POSITION_SPEED_MIN_0_100  10U
-#define ANCHOR_HEADING_SPEED_0_100       50U
-
+// Derivative low-pass for the PIDs; GNSS fixes arrive much slower than
+// the control rate
+#define NAV_D_FILTER_TAU_S               0.3f
+
+// Move mode heading hold. Output is limited so the operator's translation
+// keeps most of the thrust.
+#define MOVE_HEADING_THRUST_LIMIT        0.3f
+#define MOVE_HEADING_KP_PER_DEG          0.015f
+#define MOVE_HEADING_KI_PER_DEG_S        0.002f
+#define MOVE_HEADING_KD_S_PER_DEG        0.008f
+#define MOVE_HEADING_DEADBAND_DEG        2.0f
+
+// Cruise (MODE_CRUISE): UI speed 0-100 maps to 0 - CRUISE_MAX_SPEED_MPS over
+// ground. Feed-forward assumes drag quadratic in speed, with surge thrust 1
+// reaching CRUISE_FULL_THRUST_SPEED_MPS in still water; the PI trims the rest.
+#define CRUISE_MAX_SPEED_MPS             1.5f
+#define CRUISE_FULL_THRUST_SPEED_MPS     1.8f
+#define CRUISE_SPEED_FILTER_TAU_S        1.0f
+#define CRUISE_KP_PER_MPS                0.4f
+#define CRUISE_KI_PER_MPS_S              0.1f
+#define CRUISE_TRIM_LIMIT                0.5f
+
+// Waypoint mode: surge is scaled by cos(heading error), so the boat turns
+// towards the line-of-sight heading before driving. Heading PID outputs are
+// thrust (0-1 of a thruster pair).
+#define WAYPOINT_HEADING_KP_PER_DEG      0.02f
+#define WAYPOINT_HEADING_KI_PER_DEG_S    0.002f
+#define WAYPOINT_HEADING_KD_S_PER_DEG    0.01f
+#define WAYPOINT_HEADING_THRUST_LIMIT    0.5f
+
+// Geofence: thrust pushing back to the safe side at full strength (at the
+// boundary or in violation)
+#define GEOFENCE_PUSH_THRUST             0.6f
+
+// Weathervaning (MODE_ANCHOR_WEATHERVANE): the held heading turns at up to
+// WEATHERVANE_RATE_DPS to put the bow into the estimated drift, where hull
+// drag and so the holding thrust is least. It starts turning when the bow
+// is WEATHERVANE_ON_DEG off and stops within WEATHERVANE_OFF_DEG. Weaker
+// drift than WEATHERVANE_MIN_DRIFT (wrench units) has no useful direction.
+#define WEATHERVANE_RATE_DPS             3.0f
+#define WEATHERVANE_ON_DEG               10.0f
+#define WEATHERVANE_OFF_DEG              2.0f
+#define WEATHERVANE_MIN_DRIFT            0.02f
+
+// Shoreline following: course from the depth contour (contour.h), steered
+// with a turn proportional to the heading error.
 #define FOLLOW_SHORE_TARGET_DEPTH_CM     100.0f
-#define FOLLOW_SHORE_DEADBAND_CM         10.0f
-#define FOLLOW_SHORE_KP_CMD_PER_CM       0.6f
+#define FOLLOW_SHORE_TURN_CMD_PER_DEG    1.5f
+#define FOLLOW_SHORE_DEADBAND_DEG        2.0f
 #define FOLLOW_SHORE_MAX_DELTA_CMD       90U
 
-#define GPS_METERS_PER_DEG_LAT           111111.0f
-#define GPS_DEG_TO_RAD                   0.01745329252f
 
 static uint8_t Motor_ClampSpeedCmd(int32_t speed_cmd)
 {
@@ -85,79 +129,186 @@ static uint8_t Motor_MapSpeed0_100_to_PWM(uint8_t speed_cmd_0_100)
 	return (uint8_t)pwm;
 }
 
-static void Motor_SetForwardWithTurn(uint8_t base_cmd, direction_t turn_dir, uint8_t delta_cmd,
-											motor_speed *motor_cmd)
+// Thrust model: 0 at the deadband edge, 1 at full command.
+static float Motor_PWMToThrust(uint8_t pwm_cmd)
 {
-	if (motor_cmd == NULL)
+	if (pwm_cmd <= MOTOR_DEADBAND_MIN_ON_CMD)
 	{
-		return;
+		return 0.0f;
 	}
+	return (float)(pwm_cmd - MOTOR_DEADBAND_MIN_ON_CMD) / (float)(255U - MOTOR_DEADBAND_MIN_ON_CMD);
+}
 
-	uint32_t delta_pwm = ((uint32_t)base_cmd * (uint32_t)delta_cmd) / UI_SPEED_MAX_CMD;
-	if (delta_pwm > base_cmd)
-	{
-		delta_pwm = base_cmd;
-	}
+// Timer compare values currently output, for the slew limit
+static uint32_t motor_output_counts[THRUST_ALLOC_MOTORS];
 
-	uint8_t left_cmd = base_cmd;
-	uint8_t right_cmd = base_cmd;
-	if (turn_dir == LEFT)
+/*
+ * One control step of slew limiting on a motor's compare value. Below the
+ * motor's start point there is no thrust, so switching on jumps straight to
+ * it and switching off drops from it, rather than ramping through the
+ * deadband.
+ */
+static uint32_t Motor_SlewCounts(uint8_t motor, uint32_t current, uint32_t target)
+{
+	uint32_t start = (MOTOR_PWM_MAX_COUNTS * thrust_cal_table.cmd[motor][0]) / 255U;
+
+	if (target > current)
 	{
-		left_cmd = Motor_ClampSpeedCmd((int32_t)base_cmd - (int32_t)delta_pwm);
+		if (current < start)
+		{
+			current = (target < start) ? target : start;
+		}
+		return ((target - current) > MOTOR_SLEW_COUNTS_PER_STEP) ? (current + MOTOR_SLEW_COUNTS_PER_STEP) : target;
 	}
-	else if (turn_dir == RIGHT)
+
+	uint32_t next = ((current - target) > MOTOR_SLEW_COUNTS_PER_STEP) ? (current - MOTOR_SLEW_COUNTS_PER_STEP) : target;
+	if ((next < start) && (target < start))
 	{
-		right_cmd = Motor_ClampSpeedCmd((int32_t)base_cmd - (int32_t)delta_pwm);
+		next = target;
 	}
+	return next;
+}
 
-	motor_cmd->speed_45 = 0U;
-	motor_cmd->speed_135 = right_cmd;
-	motor_cmd->speed_225 = left_cmd;
-	motor_cmd->speed_315 = 0U;
+// Per-motor lookup from thrust to command (thrust_cal.c)
+static uint8_t Motor_ThrustToPWM(uint8_t motor, float thrust)
+{
+	return ThrustCal_ThrustToCmd(motor, thrust);
 }
 
-static bool Radar_GetAvoidanceCommand(direction_t *avoid_direction, uint8_t *delta_cmd)
+// Geofence repulsion for this control step, in the body frame
+// (MotorControl_UpdateGeofence)
+typedef struct
+{
+	float push_forward;
+	float push_right;
+	float strength;
+} MotorFence;
+
+static MotorFence motor_fence;
+
+// Wrench the thrusters were given this control step, for the drift
+// estimator (MotorControl_UpdateDrift). Not known for raw motor commands.
+static ThrustWrench motor_applied_wrench;
+static bool motor_applied_wrench_known;
+// Electrical power of that wrench, W, and of the step before
+static float motor_applied_power_w;
+static float motor_previous_power_w;
+
+// Common output path for every closed-loop mode: wrench -> thrust -> PWM.
+static void Motor_ApplyWrench(const ThrustWrench *wrench, motor_speed *motor_cmd)
 {
-	if ((avoid_direction == NULL) || (delta_cmd == NULL))
+	float thrust[THRUST_ALLOC_MOTORS];
+	ThrustWrench fenced = *wrench;
+
+	if (motor_fence.strength > 0.0f)
 	{
-		return false;
+		// Take away the part of the command heading across the boundary,
+		// all of it once in violation, then push back to the safe side.
+		float outward = (fenced.surge * motor_fence.push_forward) + (fenced.sway * motor_fence.push_right);
+		if (outward < 0.0f)
+		{
+			fenced.surge -= motor_fence.strength * outward * motor_fence.push_forward;
+			fenced.sway -= motor_fence.strength * outward * motor_fence.push_right;
+		}
+		fenced.surge += GEOFENCE_PUSH_THRUST * motor_fence.strength * motor_fence.push_forward;
+		fenced.sway += GEOFENCE_PUSH_THRUST * motor_fence.strength * motor_fence.push_right;
 	}
 
-	if (!radar_detections.radar_state)
+	ThrustAlloc_Solve(&fenced, thrust, &motor_applied_wrench);
+
+	motor_applied_power_w = 0.0f;
+	for (uint8_t m = 0U; m < THRUST_ALLOC_MOTORS; m++)
 	{
-		return false;
+		motor_applied_power_w += Loiter_MotorPowerW(thrust[m]);
 	}
 
-	uint32_t age_ms = HAL_GetTick() - radar_last_update_ms;
-	if ((radar_last_update_ms == 0U) || (age_ms > RADAR_STALE_TIMEOUT_MS))
+	motor_cmd->speed_45 = Motor_ThrustToPWM(THRUST_ALLOC_MOTOR_45, thrust[THRUST_ALLOC_MOTOR_45]);
+	motor_cmd->speed_135 = Motor_ThrustToPWM(THRUST_ALLOC_MOTOR_135, thrust[THRUST_ALLOC_MOTOR_135]);
+	motor_cmd->speed_225 = Motor_ThrustToPWM(THRUST_ALLOC_MOTOR_225, thrust[THRUST_ALLOC_MOTOR_225]);
+	motor_cmd->speed_315 = Motor_ThrustToPWM(THRUST_ALLOC_MOTOR_315, thrust[THRUST_ALLOC_MOTOR_315]);
+}
+
+// Straight translation at thrust in one of the UI directions.
+static ThrustWrench Motor_DirectionWrench(direction_t direction, float thrust)
+{
+	ThrustWrench wrench = {0.0f, 0.0f, 0.0f};
+
+	if (direction == FORWARD)
 	{
-		return false;
+		wrench.surge = thrust;
 	}
+	else if (direction == REVERSE)
+	{
+		wrench.surge = -thrust;
+	}
+	else if (direction == LEFT)
+	{
+		wrench.sway = -thrust;
+	}
+	else if (direction == RIGHT)
+	{
+		wrench.sway = thrust;
+	}
+
+	return wrench;
+}
 
-	float distance_m = radar_detections.distance;
-	float angle_deg = radar_detections.angle_deg;
+// Straight translation at speed_cmd (PWM) in one of the UI directions.
+static void Motor_SetDirection(direction_t direction, uint8_t speed_cmd, motor_speed *motor_cmd)
+{
+	ThrustWrench wrench = Motor_DirectionWrench(direction, Motor_PWMToThrust(speed_cmd));
 
-	if ((distance_m <= 0.0f) || (fabsf(angle_deg) > RADAR_FRONT_CONE_DEG))
+	Motor_ApplyWrench(&wrench, motor_cmd);
+}
+
+static void Motor_SetForwardWithTurn(uint8_t base_cmd, direction_t turn_dir, uint8_t delta_cmd,
+											motor_speed *motor_cmd)
+{
+	if (motor_cmd == NULL)
 	{
-		return false;
+		return;
 	}
 
-	if (distance_m <= RADAR_OBSTACLE_NEAR_M)
+	uint32_t delta_pwm = ((uint32_t)base_cmd * (uint32_t)delta_cmd) / UI_SPEED_MAX_CMD;
+	if (delta_pwm > base_cmd)
 	{
-		*delta_cmd = MOTOR_TURN_HARD_DELTA_CMD;
+		delta_pwm = base_cmd;
 	}
-	else if (distance_m <= RADAR_OBSTACLE_CAUTION_M)
+
+	uint8_t left_cmd = base_cmd;
+	uint8_t right_cmd = base_cmd;
+	if (turn_dir == LEFT)
 	{
-		*delta_cmd = MOTOR_TURN_SOFT_DELTA_CMD;
+		left_cmd = Motor_ClampSpeedCmd((int32_t)base_cmd - (int32_t)delta_pwm);
 	}
-	else
+	else if (turn_dir == RIGHT)
 	{
-		return false;
+		right_cmd = Motor_ClampSpeedCmd((int32_t)base_cmd - (int32_t)delta_pwm);
 	}
 
-	// Turn away from the obstacle based on angle sign.
-	*avoid_direction = (angle_deg >= 0.0f) ? LEFT : RIGHT;
-	return true;
+	// 135 at right_cmd and 225 at left_cmd, as a wrench.
+	float right_thrust = Motor_PWMToThrust(right_cmd);
+	float left_thrust = Motor_PWMToThrust(left_cmd);
+	ThrustWrench wrench;
+
+	wrench.surge = 0.5f * (right_thrust + left_thrust);
+	wrench.sway = 0.5f * (left_thrust - right_thrust);
+	wrench.yaw = 0.5f * (right_thrust - left_thrust);
+
+	Motor_ApplyWrench(&wrench, motor_cmd);
+}
+
+static float Radar_GetPredictedDistance(float distance_m)
+{
+	float closing_mps = -radar_detections.velocity_mps;
+
+	if (closing_mps <= 0.0f)
+	{
+		return distance_m;
+	}
+
+	float predicted_m = distance_m - (closing_mps * RADAR_COLLISION_LOOKAHEAD_S);
+	return (predicted_m > 0.0f) ? predicted_m : 0.0f;
 }
 
 static float GPS_NormalizeHeadingError(float heading_error_deg)
@@ -174,16 +325,58 @@ static float GPS_NormalizeHeadingError(float heading_error_deg)
 	return heading_error_deg;
 }
 
-static void GPS_CalculateOffsetMeters(double desired_lat, double desired_lon,
-																			double current_lat, double current_lon,
-																			float *north_m, float *east_m)
+/*
+ * Velocity-obstacle avoidance (obstacle.h) for forward drive at speed_cmd
+ * along the current heading. When that velocity is not admissible, gives
+ * the turn and the (lower or equal) speed command that steer for the one
+ * the planner chose instead; the turn is proportional to the heading
+ * change, so avoidance eases in and out rather than switching.
+ */
+static bool Radar_GetAvoidanceCommand(uint8_t speed_cmd, direction_t *avoid_direction,
+											uint8_t *delta_cmd, uint8_t *base_cmd)
 {
-	// Flat-earth approximation for local offsets.
-	float lat_rad = (float)desired_lat * GPS_DEG_TO_RAD;
-	float meters_per_deg_lon = GPS_METERS_PER_DEG_LAT * cosf(lat_rad);
+	if ((avoid_direction == NULL) || (delta_cmd == NULL) || (base_cmd == NULL))
+	{
+		return false;
+	}
+
+	float heading_deg = (float)GPS_Data.rotation.E;
+	float speed_mps = CRUISE_FULL_THRUST_SPEED_MPS * sqrtf(Motor_PWMToThrust(speed_cmd));
+	float preferred_north = speed_mps * cosf(heading_deg * GPS_DEG_TO_RAD);
+	float preferred_east = speed_mps * sinf(heading_deg * GPS_DEG_TO_RAD);
+	float chosen_north = 0.0f;
+	float chosen_east = 0.0f;
+
+	if (!Obstacle_PlanVelocity(preferred_north, preferred_east, &chosen_north, &chosen_east))
+	{
+		return false;
+	}
+
+	float chosen_mps = sqrtf((chosen_north * chosen_north) + (chosen_east * chosen_east));
+	float fraction = (speed_mps > 0.0f) ? (chosen_mps / speed_mps) : 0.0f;
+	if (fraction > 1.0f)
+	{
+		fraction = 1.0f;
+	}
+
+	// Thrust goes with speed squared; inverse of Motor_PWMToThrust
+	float thrust = Motor_PWMToThrust(speed_cmd) * fraction * fraction;
+	*base_cmd = (thrust > 0.0f)
+		? Motor_ClampSpeedCmd((int32_t)((float)MOTOR_DEADBAND_MIN_ON_CMD + (thrust * (float)(255U - MOTOR_DEADBAND_MIN_ON_CMD))))
+		: 0U;
+
+	// Stopping keeps the heading
+	float turn_deg = 0.0f;
+	if (chosen_mps > 0.0f)
+	{
+		turn_deg = GPS_NormalizeHeadingError((atan2f(chosen_east, chosen_north) / GPS_DEG_TO_RAD) - heading_deg);
+	}
 
-	*north_m = (float)((current_lat - desired_lat) * GPS_METERS_PER_DEG_LAT);
-	*east_m = (float)((current_lon - desired_lon) * meters_per_deg_lon);
+	float delta_f = fabsf(turn_deg) * RADAR_AVOID_TURN_CMD_PER_DEG;
+	*delta_cmd = (delta_f > (float)MOTOR_TURN_HARD_DELTA_CMD) ? (uint8_t)MOTOR_TURN_HARD_DELTA_CMD : (uint8_t)delta_f;
+	// Slowing the LEFT (225) side turns clockwise, as in the heading hold
+	*avoid_direction = (turn_deg >= 0.0f) ? LEFT : RIGHT;
+	return true;
 }
 
 /**
@@ -204,27 +397,28 @@ static void WorldToBody(float north_m, float east_m, float heading_deg,
 }
 
 
-static uint8_t Anchor_ComputePositionSpeed(float distance_m)
+// Surge thrust that holds the cruise speed over ground.
+static float Cruise_ComputeThrust(MotorControlState *state)
 {
-	float distance_span = ANCHOR_POSITION_ON_M - ANCHOR_POSITION_OFF_M;
-	float ratio = 1.0f;
-	float speed_range = (float)(ANCHOR_POSITION_SPEED_MAX_0_100 - ANCHOR_POSITION_SPEED_MIN_0_100);
+	// First-order low-pass on GNSS speed: fixes are slow and noisy next to
+	// the control rate.
+	float alpha = CONTROL_LOOP_DT_S / (CRUISE_SPEED_FILTER_TAU_S + CONTROL_LOOP_DT_S);
+	state->cruise_speed_est_mps += alpha * ((float)GPS_Data.ground_speed - state->cruise_speed_est_mps);
 
-	if (distance_span > 0.0f)
-	{
-		ratio = (distance_m - ANCHOR_POSITION_OFF_M) / distance_span;
-	}
-	if (ratio < 0.0f)
+	float ratio = state->cruise_target_mps / CRUISE_FULL_THRUST_SPEED_MPS;
+	float feed_forward = ratio * ratio;
+	float trim = PID_Update(&state->cruise_speed_pid, state->cruise_target_mps - state->cruise_speed_est_mps);
+	float thrust = feed_forward + trim;
+
+	if (thrust < 0.0f)
 	{
-		ratio = 0.0f;
+		thrust = 0.0f;
 	}
-	else if (ratio > 1.0f)
+	else if (thrust > 1.0f)
 	{
-		ratio = 1.0f;
+		thrust = 1.0f;
 	}
-
-	uint8_t speed_0_100 = (uint8_t)(ANCHOR_POSITION_SPEED_MIN_0_100 + (ratio * speed_range));
-	return Motor_MapSpeed0_100_to_PWM(speed_0_100);
+	return thrust;
 }
 
 void MotorControl_InitState(MotorControlState *state)
@@ -246,8 +440,81 @@ void MotorControl_InitState(MotorControlState *state)
 	state->anchor_desired_latitude = 0.0;
 	state->anchor_desired_longitude = 0.0;
 	state->anchor_desired_heading_deg = 0.0f;
+	state->anchor_weathervane = false;
+	state->anchor_weathervane_turning = false;
 	state->anchor_heading_correction_active = false;
 	state->anchor_position_correction_active = false;
+	PID_Init(&state->move_heading_pid, MOVE_HEADING_KP_PER_DEG, MOVE_HEADING_KI_PER_DEG_S,
+			 MOVE_HEADING_KD_S_PER_DEG, CONTROL_LOOP_DT_S, NAV_D_FILTER_TAU_S,
+			 -MOVE_HEADING_THRUST_LIMIT, MOVE_HEADING_THRUST_LIMIT);
+	state->cruise_enabled = false;
+	state->cruise_target_mps = 0.0f;
+	state->cruise_speed_est_mps = 0.0f;
+	PID_Init(&state->cruise_speed_pid, CRUISE_KP_PER_MPS, CRUISE_KI_PER_MPS_S, 0.0f,
+			 CONTROL_LOOP_DT_S, 0.0f, -CRUISE_TRIM_LIMIT, CRUISE_TRIM_LIMIT);
+	PID_Init(&state->waypoint_heading_pid, WAYPOINT_HEADING_KP_PER_DEG, WAYPOINT_HEADING_KI_PER_DEG_S,
+			 WAYPOINT_HEADING_KD_S_PER_DEG, CONTROL_LOOP_DT_S, NAV_D_FILTER_TAU_S,
+			 -WAYPOINT_HEADING_THRUST_LIMIT, WAYPOINT_HEADING_THRUST_LIMIT);
+	AnchorMpc_Init();
+}
+
+void MotorControl_UpdateDrift(operatingMode_t mode)
+{
+	Drift_Update(motor_applied_wrench_known ? &motor_applied_wrench : NULL);
+
+	// Until a mode applies a wrench the thrusters are off
+	motor_applied_wrench.surge = 0.0f;
+	motor_applied_wrench.sway = 0.0f;
+	motor_applied_wrench.yaw = 0.0f;
+	motor_previous_power_w = motor_applied_power_w;
+	motor_applied_power_w = 0.0f;
+	motor_applied_wrench_known = (mode != MOTOR_OVERRIDE) && (mode != MOTOR_CALIBRATE);
+}
+
+// Heading PID output plus the thrust that cancels the estimated yaw drift
+static float Motor_HeadingWithDrift(float pid_yaw, float limit)
+{
+	float yaw = pid_yaw - drift_estimate.yaw;
+
+	if (drift_estimate.settled_s < DRIFT_SETTLE_S)
+	{
+		yaw = pid_yaw;
+	}
+	if (yaw > limit)
+	{
+		yaw = limit;
+	}
+	else if (yaw < -limit)
+	{
+		yaw = -limit;
+	}
+	return yaw;
+}
+
+void MotorControl_UpdateGeofence(operatingMode_t mode)
+{
+	GeofenceResult fence;
+
+	Geofence_Poll();
+
+	motor_fence.push_forward = 0.0f;
+	motor_fence.push_right = 0.0f;
+	motor_fence.strength = 0.0f;
+
+	// Anchor holds a point the operator chose; override and calibration are raw.
+	if ((mode != MODE_MOVE) && (mode != MODE_CRUISE) && (mode != MODE_FOLLOW_SHORE) && (mode != MODE_WAYPOINT))
+	{
+		return;
+	}
+
+	if (!Geofence_Query(GPS_Data.world_position_avg.N, GPS_Data.world_position_avg.E, &fence))
+	{
+		return;
+	}
+
+	WorldToBody(fence.push_north, fence.push_east, (float)GPS_Data.rotation.E,
+				&motor_fence.push_forward, &motor_fence.push_right);
+	motor_fence.strength = fence.strength;
 }
 
 void MotorControl_ModeMove(MotorControlState *state, bool mode_entry, bool got_ui_update,
@@ -272,6 +539,19 @@ void MotorControl_ModeMove(MotorControlState *state, bool mode_entry, bool got_u
 		state->desired_drive_direction = ui->direction_to_turn;
 	}
 
+	if (mode_entry || got_ui_update)
+	{
+		// Hold the heading the boat had when the command was given.
+		state->move_desired_heading_deg = (float)GPS_Data.rotation.E;
+		state->move_heading_correction_active = false;
+		PID_Reset(&state->move_heading_pid);
+
+		state->cruise_enabled = (ui->mode == MODE_CRUISE);
+		state->cruise_target_mps = ((float)ui->speed * CRUISE_MAX_SPEED_MPS) / (float)UI_SPEED_MAX_CMD;
+		state->cruise_speed_est_mps = (float)GPS_Data.ground_speed;
+		PID_Reset(&state->cruise_speed_pid);
+	}
+
 	if (state->desired_speed_cmd == 0U)
 	{
 		motor_cmd->speed_45 = 0U;
@@ -290,10 +570,7 @@ void MotorControl_ModeMove(MotorControlState *state, bool mode_entry, bool got_u
 		uint8_t speed_cmd = Motor_MapSpeed0_100_to_PWM(UI_SPEED_MAX_CMD);
 		if (state->desired_drive_direction == FORWARD)
 		{
-			motor_cmd->speed_45 = speed_cmd;
-			motor_cmd->speed_135 = 0U;
-			motor_cmd->speed_225 = 0U;
-			motor_cmd->speed_315 = speed_cmd;
+			Motor_SetDirection(REVERSE, speed_cmd, motor_cmd);
 			return;
 		}
 		// else if (state->desired_drive_direction == REVERSE)
@@ -312,18 +589,16 @@ void MotorControl_ModeMove(MotorControlState *state, bool mode_entry, bool got_u
 
 	if (radar_detections.radar_state)
 	{
+		float predicted_m = Radar_GetPredictedDistance(radar_detections.distance);
 		bool radar_front_object = (radar_detections.distance > 0.0f)
-			&& (radar_detections.distance < RADAR_EMERGENCY_REVERSE_M)
+			&& (predicted_m < RADAR_EMERGENCY_REVERSE_M)
 			&& (radar_detections.distance > RADAR_EMERGENCY_MIN_M)
 			&& (fabsf(radar_detections.angle_deg) <= RADAR_FRONT_CONE_DEG);
 
 		if ((state->desired_drive_direction == FORWARD) && radar_front_object)
 		{
 			uint8_t speed_cmd = Motor_MapSpeed0_100_to_PWM(UI_SPEED_MAX_CMD);
-			motor_cmd->speed_45 = speed_cmd;
-			motor_cmd->speed_135 = 0U;
-			motor_cmd->speed_225 = 0U;
-			motor_cmd->speed_315 = speed_cmd;
+			Motor_SetDirection(REVERSE, speed_cmd, motor_cmd);
 			if (mode_entry_out != NULL)
 			{
 				*mode_entry_out = false;
@@ -332,42 +607,86 @@ void MotorControl_ModeMove(MotorControlState *state, bool mode_entry, bool got_u
 		}
 	}
 
-	if (state->desired_drive_direction == FORWARD)
 	{
-		motor_cmd->speed_45 = 0U;
-		motor_cmd->speed_135 = state->desired_speed_cmd;
-		motor_cmd->speed_225 = state->desired_speed_cmd;
-		motor_cmd->speed_315 = 0U;
+		float thrust = state->cruise_enabled ? Cruise_ComputeThrust(state)
+											 : Motor_PWMToThrust(state->desired_speed_cmd);
+		ThrustWrench wrench = Motor_DirectionWrench(state->desired_drive_direction, thrust);
+
+		// Heading hold from NAV-ATT yaw: differential thrust on top of the
+		// translation cancels the turn from wind and current.
+		float heading_error_deg = GPS_NormalizeHeadingError((float)GPS_Data.rotation.E - state->move_desired_heading_deg);
+		if (fabsf(heading_error_deg) < MOVE_HEADING_DEADBAND_DEG)
+		{
+			heading_error_deg = 0.0f;
+		}
+
+		wrench.yaw = Motor_HeadingWithDrift(PID_Update(&state->move_heading_pid, -heading_error_deg),
+											MOVE_HEADING_THRUST_LIMIT);
+		state->move_heading_correction_active = (fabsf(wrench.yaw) >= THRUST_ALLOC_MIN_THRUST);
+
+		Motor_ApplyWrench(&wrench, motor_cmd);
 	}
-	else if (state->desired_drive_direction == REVERSE)
+
+	if (mode_entry_out != NULL)
 	{
-		motor_cmd->speed_45 = state->desired_speed_cmd;
-		motor_cmd->speed_135 = 0U;
-		motor_cmd->speed_225 = 0U;
-		motor_cmd->speed_315 = state->desired_speed_cmd;
+		*mode_entry_out = false;
 	}
-	else if (state->desired_drive_direction == LEFT)
+}
+
+/*
+ * Turn the held anchor heading towards the bow-into-drift heading, rate
+ * limited so the MPC sees a slow ramp rather than a step.
+ */
+static void Anchor_Weathervane(MotorControlState *state)
+{
+	float drift = sqrtf((drift_estimate.north * drift_estimate.north)
+		+ (drift_estimate.east * drift_estimate.east));
+
+	if ((drift_estimate.settled_s < DRIFT_SETTLE_S) || (drift < WEATHERVANE_MIN_DRIFT))
 	{
-		motor_cmd->speed_45 = state->desired_speed_cmd;
-		motor_cmd->speed_135 = state->desired_speed_cmd;
-		motor_cmd->speed_225 = 0U;
-		motor_cmd->speed_315 = 0U;
+		state->anchor_weathervane_turning = false;
+		return;
 	}
-	else if (state->desired_drive_direction == RIGHT)
+
+	// The drift pushes the boat along (north, east); the bow goes the other way
+	float target_deg = atan2f(-drift_estimate.east, -drift_estimate.north) / GPS_DEG_TO_RAD;
+	float error_deg = GPS_NormalizeHeadingError(target_deg - state->anchor_desired_heading_deg);
+
+	if (!state->anchor_weathervane_turning && (fabsf(error_deg) > WEATHERVANE_ON_DEG))
 	{
-		motor_cmd->speed_45 = 0U;
-		motor_cmd->speed_135 = 0U;
-		motor_cmd->speed_225 = state->desired_speed_cmd;
-		motor_cmd->speed_315 = state->desired_speed_cmd;
+		state->anchor_weathervane_turning = true;
+	}
+	else if (state->anchor_weathervane_turning && (fabsf(error_deg) < WEATHERVANE_OFF_DEG))
+	{
+		state->anchor_weathervane_turning = false;
+	}
+	if (!state->anchor_weathervane_turning)
+	{
+		return;
 	}
 
-	if (mode_entry_out != NULL)
+	float step_deg = WEATHERVANE_RATE_DPS * CONTROL_LOOP_DT_S;
+	if (error_deg > step_deg)
 	{
-		*mode_entry_out = false;
+		error_deg = step_deg;
+	}
+	else if (error_deg < -step_deg)
+	{
+		error_deg = -step_deg;
+	}
+
+	state->anchor_desired_heading_deg += error_deg;
+	if (state->anchor_desired_heading_deg >= 360.0f)
+	{
+		state->anchor_desired_heading_deg -= 360.0f;
+	}
+	else if (state->anchor_desired_heading_deg < 0.0f)
+	{
+		state->anchor_desired_heading_deg += 360.0f;
 	}
 }
 
-void MotorControl_ModeAnchor(MotorControlState *state, bool mode_entry,
+void MotorControl_ModeAnchor(MotorControlState *state, bool mode_entry, bool weathervane,
 									 motor_speed *motor_cmd,
 														 bool *mode_entry_out)
 {
@@ -382,99 +701,54 @@ void MotorControl_ModeAnchor(MotorControlState *state, bool mode_entry,
 		state->anchor_desired_latitude = GPS_Data.world_position_avg.N;
 		state->anchor_desired_longitude = GPS_Data.world_position_avg.E;
 		state->anchor_desired_heading_deg = (float)GPS_Data.rotation.E;
+		state->anchor_weathervane = weathervane;
+		state->anchor_weathervane_turning = false;
 		state->anchor_heading_correction_active = false;
 		state->anchor_position_correction_active = false;
+		// Start the plan from the boat's current motion
+		float velocity[ANCHOR_MPC_AXES];
+		WorldToBody(drift_estimate.velocity_north, drift_estimate.velocity_east,
+					state->anchor_desired_heading_deg,
+					&velocity[ANCHOR_MPC_AXIS_SURGE], &velocity[ANCHOR_MPC_AXIS_SWAY]);
+		velocity[ANCHOR_MPC_AXIS_YAW] = drift_estimate.yaw_rate_dps;
+		AnchorMpc_Reset(velocity);
 	}
 
+	if (state->anchor_weathervane)
 	{
-		// Zero outputs initially
-		motor_cmd->speed_45 = 0U;
-		motor_cmd->speed_135 = 0U;
-		motor_cmd->speed_225 = 0U;
-		motor_cmd->speed_315 = 0U;
+		Anchor_Weathervane(state);
+	}
 
-		// Priority: heading correction, then position correction.
+	{
 		float north_m = 0.0f;
 		float east_m = 0.0f;
 		GPS_CalculateOffsetMeters(state->anchor_desired_latitude, state->anchor_desired_longitude,
 													GPS_Data.world_position_avg.N, GPS_Data.world_position_avg.E,
 													&north_m, &east_m);
-		float distance_m = sqrtf((north_m * north_m) + (east_m * east_m));
-		uint8_t anchor_position_speed_cmd = Anchor_ComputePositionSpeed(distance_m);
-
-		state->anchor_position_correction_active = (distance_m > ANCHOR_POSITION_ON_M);
 
-		// Heading correction (hysteresis)
+		// Where the boat is relative to the anchor point, in the body frame
 		float current_heading_deg = (float)GPS_Data.rotation.E;
-		float heading_error_deg = GPS_NormalizeHeadingError(current_heading_deg - state->anchor_desired_heading_deg);
-		uint8_t anchor_heading_speed_cmd = Motor_MapSpeed0_100_to_PWM(ANCHOR_HEADING_SPEED_0_100);
+		float offset[ANCHOR_MPC_AXES];
+		WorldToBody(north_m, east_m, current_heading_deg,
+					&offset[ANCHOR_MPC_AXIS_SURGE], &offset[ANCHOR_MPC_AXIS_SWAY]);
 
-		if (!state->anchor_heading_correction_active && (fabsf(heading_error_deg) > ANCHOR_HEADING_ON_DEG))
-		{
-			state->anchor_heading_correction_active = true;
-		}
-		else if (state->anchor_heading_correction_active && (fabsf(heading_error_deg) < ANCHOR_HEADING_OFF_DEG))
-		{
-			state->anchor_heading_correction_active = false;
-		}
+		// Positive heading error means the bow has swung clockwise
+		offset[ANCHOR_MPC_AXIS_YAW] = GPS_NormalizeHeadingError(current_heading_deg - state->anchor_desired_heading_deg);
 
-		if (state->anchor_heading_correction_active)
-		{
-			// Rotate in place to regain heading (use mapped speeds)
-			if (heading_error_deg > 0.0f)
-			{
-				// rotate counter-clockwise -> motors 45 + 225
-				motor_cmd->speed_45 = anchor_heading_speed_cmd;
-				motor_cmd->speed_225 = anchor_heading_speed_cmd;
-			}
-			else if (heading_error_deg < 0.0f)
-			{
-				// rotate clockwise -> motors 135 + 315
-				motor_cmd->speed_135 = anchor_heading_speed_cmd;
-				motor_cmd->speed_315 = anchor_heading_speed_cmd;
-			}
-		}
+		// Known drift goes into the plan as a disturbance, so it is
+		// cancelled before it shows up as an offset.
+		ThrustWrench drift;
+		Drift_BodyWrench(current_heading_deg, &drift);
 
-		// Position correction only when heading is stable
-		if (state->anchor_position_correction_active && !state->anchor_heading_correction_active)
-		{
-			// Convert world offsets into body frame so position correction aims at world coordinates
-			float body_forward_m = 0.0f;
-			float body_right_m = 0.0f;
-			WorldToBody(-north_m, -east_m, (float)GPS_Data.rotation.E, &body_forward_m, &body_right_m);
+		// The allocator gives yaw priority over sway over surge when saturated.
+		ThrustWrench wrench;
+		AnchorMpc_Update(offset, &drift, &wrench);
 
-			// Lateral correction (body right/left) first
-			if (fabsf(body_right_m) > ANCHOR_POSITION_OFF_M)
-			{
-				if (body_right_m > 0.0f)
-				{
-					// Need to move right in body frame -> use motors 225 + 315
-					motor_cmd->speed_225 = anchor_position_speed_cmd;
-					motor_cmd->speed_315 = anchor_position_speed_cmd;
-				}
-				else
-				{
-					// Need to move left in body frame -> use motors 45 + 135
-					motor_cmd->speed_45 = anchor_position_speed_cmd;
-					motor_cmd->speed_135 = anchor_position_speed_cmd;
-				}
-			}
-			else if (fabsf(body_forward_m) > ANCHOR_POSITION_OFF_M)
-			{
-				if (body_forward_m > 0.0f)
-				{
-					// Need to move forward in body frame -> use motors 135 + 225
-					motor_cmd->speed_135 = anchor_position_speed_cmd;
-					motor_cmd->speed_225 = anchor_position_speed_cmd;
-				}
-				else
-				{
-					// Need to move backward in body frame -> use motors 45 + 315
-					motor_cmd->speed_45 = anchor_position_speed_cmd;
-					motor_cmd->speed_315 = anchor_position_speed_cmd;
-				}
-			}
-		}
+		state->anchor_heading_correction_active = (fabsf(wrench.yaw) >= THRUST_ALLOC_MIN_THRUST);
+		state->anchor_position_correction_active = (fabsf(wrench.surge) >= THRUST_ALLOC_MIN_THRUST)
+			|| (fabsf(wrench.sway) >= THRUST_ALLOC_MIN_THRUST);
+
+		Motor_ApplyWrench(&wrench, motor_cmd);
 	}
 
 	if (mode_entry_out != NULL)
@@ -484,7 +758,8 @@ void MotorControl_ModeAnchor(MotorControlState *state, bool mode_entry,
 }
 
 void MotorControl_ModeFollowShore(MotorControlState *state, bool mode_entry, bool got_ui_update,
-																	const UIdata *ui, bool sonar_data_valid, const Sonar_t *sonar,
+																	const UIdata *ui, bool sonar_data_valid, bool got_sonar_update,
+																	const Sonar_t *sonar,
 												motor_speed *motor_cmd,
 																	bool *mode_entry_out)
 {
@@ -493,7 +768,9 @@ void MotorControl_ModeFollowShore(MotorControlState *state, bool mode_entry, boo
 		return;
 	}
 
-	if (mode_entry)
+	// Every UI frame re-enters the mode. Keep the learned contour and target
+	// depth through a speed change; start again only on a new shore side.
+	if (mode_entry && (!contour_status.running || (ui->direction_to_turn != state->desired_shore_side)))
 	{
 		// Initialize shoreline tracking intent from UI.
 		state->desired_speed_cmd = Motor_MapSpeed0_100_to_PWM(ui->speed);
@@ -508,12 +785,13 @@ void MotorControl_ModeFollowShore(MotorControlState *state, bool mode_entry, boo
 		{
 			state->follow_target_depth_cm = FOLLOW_SHORE_TARGET_DEPTH_CM;
 		}
+		Contour_Start(state->follow_desired_heading_deg, state->desired_shore_side,
+					  state->follow_target_depth_cm);
 	}
 
 	if (got_ui_update)
 	{
 		state->desired_speed_cmd = Motor_MapSpeed0_100_to_PWM(ui->speed);
-		state->desired_shore_side = ui->direction_to_turn;
 	}
 
 	if (state->desired_speed_cmd == 0U)
@@ -529,76 +807,49 @@ void MotorControl_ModeFollowShore(MotorControlState *state, bool mode_entry, boo
 		return;
 	}
 
-	bool depth_valid = sonar_data_valid && (sonar->distance > 0.0f);
-	float depth_error_cm = 0.0f;
-
-	if (depth_valid)
+	if (got_sonar_update && (sonar->distance > 0.0f))
 	{
-		depth_error_cm = state->follow_target_depth_cm - sonar->distance;
+		Contour_AddSample(sonar->distance);
 	}
 
-	// Radar avoidance takes priority over shoreline depth control.
+	// Radar avoidance takes priority over contour following.
 	direction_t radar_avoid_dir = RIGHT;
 	uint8_t radar_delta_cmd = 0U;
-	if (Radar_GetAvoidanceCommand(&radar_avoid_dir, &radar_delta_cmd))
+	uint8_t radar_base_cmd = 0U;
+	if (Radar_GetAvoidanceCommand(state->desired_speed_cmd, &radar_avoid_dir, &radar_delta_cmd, &radar_base_cmd))
 	{
-		Motor_SetForwardWithTurn(state->desired_speed_cmd, radar_avoid_dir, radar_delta_cmd, motor_cmd);
+		Motor_SetForwardWithTurn(radar_base_cmd, radar_avoid_dir, radar_delta_cmd, motor_cmd);
 		state->follow_heading_correction_active = false;
 	}
-	else if (depth_valid && (fabsf(depth_error_cm) > FOLLOW_SHORE_DEADBAND_CM))
+	else
 	{
-		// Depth control: steer toward/away from shore side to maintain target depth.
-		direction_t correction_direction = state->desired_shore_side;
-		if (depth_error_cm > 0.0f)
+		// Steer for the course along the target isobath; on a bottom too
+		// flat to follow, hold the last one.
+		float course_deg = 0.0f;
+		if (Contour_Steer(&course_deg))
 		{
-			correction_direction = (state->desired_shore_side == RIGHT) ? LEFT : RIGHT;
+			state->follow_desired_heading_deg = course_deg;
 		}
 
-		float delta_f = fabsf(depth_error_cm) * FOLLOW_SHORE_KP_CMD_PER_CM;
-		uint8_t delta_cmd = (uint8_t)delta_f;
-		if (delta_cmd > FOLLOW_SHORE_MAX_DELTA_CMD)
-		{
-			delta_cmd = FOLLOW_SHORE_MAX_DELTA_CMD;
-		}
-		if (delta_cmd < MOTOR_TURN_SOFT_DELTA_CMD)
+		float heading_error_deg = GPS_NormalizeHeadingError(state->follow_desired_heading_deg - (float)GPS_Data.rotation.E);
+		if (fabsf(heading_error_deg) < FOLLOW_SHORE_DEADBAND_DEG)
 		{
-			delta_cmd = MOTOR_TURN_SOFT_DELTA_CMD;
+			heading_error_deg = 0.0f;
 		}
 
-		Motor_SetForwardWithTurn(state->desired_speed_cmd, correction_direction, delta_cmd, motor_cmd);
-		state->follow_heading_correction_active = false;
-	}
-	else
-	{
-		// Hold heading using GPS when depth is stable or invalid.
-		float current_heading_deg = (float)GPS_Data.rotation.E;
-		float heading_error_deg = GPS_NormalizeHeadingError(current_heading_deg - state->follow_desired_heading_deg);
+		// Turn in proportion to the heading error. Slowing the LEFT (225)
+		// side turns clockwise.
+		float delta_f = fabsf(heading_error_deg) * FOLLOW_SHORE_TURN_CMD_PER_DEG;
+		uint8_t delta_cmd = (delta_f > (float)FOLLOW_SHORE_MAX_DELTA_CMD) ? (uint8_t)FOLLOW_SHORE_MAX_DELTA_CMD : (uint8_t)delta_f;
+		direction_t turn_direction = (heading_error_deg >= 0.0f) ? LEFT : RIGHT;
 
-		if (!state->follow_heading_correction_active && (fabsf(heading_error_deg) > ANCHOR_HEADING_ON_DEG))
-		{
-			state->follow_heading_correction_active = true;
-		}
-		else if (state->follow_heading_correction_active && (fabsf(heading_error_deg) < ANCHOR_HEADING_OFF_DEG))
-		{
-			state->follow_heading_correction_active = false;
-		}
-
-		if (state->follow_heading_correction_active)
-		{
-			direction_t correction_direction = (heading_error_deg > 0.0f) ? RIGHT : LEFT;
-			Motor_SetForwardWithTurn(state->desired_speed_cmd, correction_direction, 0U, motor_cmd);
-		}
-		else
-		{
-			Motor_SetForwardWithTurn(state->desired_speed_cmd, LEFT, 0U, motor_cmd);
-		}
-		Motor_SetForwardWithTurn(state->desired_speed_cmd, LEFT, 0U, motor_cmd);
-		state->follow_heading_correction_active = false;
+		Motor_SetForwardWithTurn(state->desired_speed_cmd, turn_direction, delta_cmd, motor_cmd);
+		state->follow_heading_correction_active = (delta_cmd > 0U);
 	}
 
-	// Enforce forward-only drive in shoreline follow (max two motors).
-	motor_cmd->speed_45 = 0U;
-	motor_cmd->speed_315 = 0U;
+	// Forward-only drive comes from the wrench: forward with a turn allocates
+	// to 135 and 225 alone. Only geofence repulsion (Motor_ApplyWrench) uses
+	// 45 and 315, to slow or back the boat off a boundary.
 
 	if (mode_entry_out != NULL)
 	{
@@ -620,23 +871,152 @@ void MotorControl_ModeOverride(const UIdata *ui,
 	motor_cmd->speed_315 = Motor_MapSpeed0_100_to_PWM(ui->override_speed315);
 }
 
-void MotorControl_SetOutputs(const motor_speed *motor_cmd)
+void MotorControl_ModeWaypoint(MotorControlState *state, bool mode_entry, const UIdata *ui,
+									motor_speed *motor_cmd,
+									bool *mode_entry_out)
+{
+	if ((state == NULL) || (ui == NULL) || (motor_cmd == NULL))
+	{
+		return;
+	}
+
+	double latitude = GPS_Data.world_position_avg.N;
+	double longitude = GPS_Data.world_position_avg.E;
+	float cruise_mps = ((float)ui->speed * CRUISE_MAX_SPEED_MPS) / (float)UI_SPEED_MAX_CMD;
+
+	if (mode_entry)
+	{
+		Waypoint_Start(latitude, longitude);
+		PID_Reset(&state->waypoint_heading_pid);
+		state->cruise_speed_est_mps = (float)GPS_Data.ground_speed;
+		PID_Reset(&state->cruise_speed_pid);
+	}
+
+	float heading_sp_deg = 0.0f;
+	float speed_sp_mps = 0.0f;
+
+	if ((ui->speed == 0U) || !Waypoint_Update(latitude, longitude, cruise_mps, &heading_sp_deg, &speed_sp_mps))
+	{
+		// No route, finished, or stopped from the UI
+		motor_cmd->speed_45 = 0U;
+		motor_cmd->speed_135 = 0U;
+		motor_cmd->speed_225 = 0U;
+		motor_cmd->speed_315 = 0U;
+	}
+	else
+	{
+		float heading_error_deg = GPS_NormalizeHeadingError((float)GPS_Data.rotation.E - heading_sp_deg);
+		float alignment = cosf(heading_error_deg * GPS_DEG_TO_RAD);
+		ThrustWrench wrench = {0.0f, 0.0f, 0.0f};
+
+		state->cruise_target_mps = (alignment > 0.0f) ? (speed_sp_mps * alignment) : 0.0f;
+		wrench.surge = Cruise_ComputeThrust(state);
+		wrench.yaw = Motor_HeadingWithDrift(PID_Update(&state->waypoint_heading_pid, -heading_error_deg),
+											WAYPOINT_HEADING_THRUST_LIMIT);
+
+		Motor_ApplyWrench(&wrench, motor_cmd);
+	}
+
+	if (mode_entry_out != NULL)
+	{
+		*mode_entry_out = false;
+	}
+}
+
+void MotorControl_ModeLoiter(bool mode_entry, const UIdata *ui,
+								motor_speed *motor_cmd,
+								bool *mode_entry_out)
 {
+	double latitude = GPS_Data.world_position_avg.N;
+	double longitude = GPS_Data.world_position_avg.E;
+	// Energy is counted a step late, from what the last step commanded
+	float power_w = motor_previous_power_w;
+	float thrust_north = 0.0f;
+	float thrust_east = 0.0f;
+	ThrustWrench wrench = {0.0f, 0.0f, 0.0f};
+
+	if ((ui == NULL) || (motor_cmd == NULL))
+	{
+		return;
+	}
+
+	if (mode_entry)
+	{
+		// UI speed is the radius in metres
+		Loiter_Start(latitude, longitude, (float)ui->speed);
+	}
+
+	// No heading control: the boat may swing freely, thrust is set in
+	// the world frame and turned into body axes here.
+	Loiter_Update(latitude, longitude, power_w, &thrust_north, &thrust_east);
+	WorldToBody(thrust_north, thrust_east, (float)GPS_Data.rotation.E, &wrench.surge, &wrench.sway);
+
+	Motor_ApplyWrench(&wrench, motor_cmd);
+
+	if (mode_entry_out != NULL)
+	{
+		*mode_entry_out = false;
+	}
+}
+
+void MotorControl_ModeCalibrate(bool mode_entry,
+									motor_speed *motor_cmd,
+									bool *mode_entry_out)
+{
+	uint8_t cmd[THRUST_ALLOC_MOTORS];
+
 	if (motor_cmd == NULL)
 	{
 		return;
 	}
 
-	// Convert 0-255 commands to timer counts.
-	uint32_t motor_45_arr = (MOTOR_PWM_MAX_COUNTS * motor_cmd->speed_45) / 255;
-	uint32_t motor_135_arr = (MOTOR_PWM_MAX_COUNTS * motor_cmd->speed_135) / 255;
-	uint32_t motor_225_arr = (MOTOR_PWM_MAX_COUNTS * motor_cmd->speed_225) / 255;
-	uint32_t motor_315_arr = (MOTOR_PWM_MAX_COUNTS * motor_cmd->speed_315) / 255;
-
-	__HAL_TIM_SET_COMPARE(&htim2, TIM_CHANNEL_1, motor_45_arr);
-	__HAL_TIM_SET_COMPARE(&htim2, TIM_CHANNEL_2, motor_135_arr);
-	__HAL_TIM_SET_COMPARE(&htim2, TIM_CHANNEL_3, motor_225_arr);
-	__HAL_TIM_SET_COMPARE(&htim2, TIM_CHANNEL_4, motor_315_arr);
+	if (mode_entry)
+	{
+		// Any new UI command in this mode restarts the sweep
+		ThrustCal_Start();
+	}
+
+	// Outputs stay at zero once the sweep has finished; check
+	// thrust_cal_status for the result.
+	(void)ThrustCal_Step((float)GPS_Data.rotation.E, cmd);
+
+	motor_cmd->speed_45 = cmd[THRUST_ALLOC_MOTOR_45];
+	motor_cmd->speed_135 = cmd[THRUST_ALLOC_MOTOR_135];
+	motor_cmd->speed_225 = cmd[THRUST_ALLOC_MOTOR_225];
+	motor_cmd->speed_315 = cmd[THRUST_ALLOC_MOTOR_315];
+
+	if (mode_entry_out != NULL)
+	{
+		*mode_entry_out = false;
+	}
 }
 
+void MotorControl_SetOutputs(const motor_speed *motor_cmd)
+{
+	if (motor_cmd == NULL)
+	{
+		return;
+	}
 
+	// Convert 0-255 commands to timer counts.
+	uint32_t target[THRUST_ALLOC_MOTORS];
+	target[THRUST_ALLOC_MOTOR_45] = (MOTOR_PWM_MAX_COUNTS * motor_cmd->speed_45) / 255;
+	target[THRUST_ALLOC_MOTOR_135] = (MOTOR_PWM_MAX_COUNTS * motor_cmd->speed_135) / 255;
+	target[THRUST_ALLOC_MOTOR_225] = (MOTOR_PWM_MAX_COUNTS * motor_cmd->speed_225) / 255;
+	target[THRUST_ALLOC_MOTOR_315] = (MOTOR_PWM_MAX_COUNTS * motor_cmd->speed_315) / 255;
+
+	for (uint8_t m = 0U; m < THRUST_ALLOC_MOTORS; m++)
+	{
+		motor_output_counts[m] = Motor_SlewCounts(m, motor_output_counts[m], target[m]);
+	}
+
+	// CCR and ARR preload are on. Holding off update events while the four
+	// compares are written makes the next update latch them together, so a
+	// PWM period never mixes old and new commands.
+	SET_BIT(htim2.Instance->CR1, TIM_CR1_UDIS);
+	__HAL_TIM_SET_COMPARE(&htim2, TIM_CHANNEL_1, motor_output_counts[THRUST_ALLOC_MOTOR_45]);
+	__HAL_TIM_SET_COMPARE(&htim2, TIM_CHANNEL_2, motor_output_counts[THRUST_ALLOC_MOTOR_135]);
+	__HAL_TIM_SET_COMPARE(&htim2, TIM_CHANNEL_3, motor_output_counts[THRUST_ALLOC_MOTOR_225]);
+	__HAL_TIM_SET_COMPARE(&htim2, TIM_CHANNEL_4, motor_output_counts[THRUST_ALLOC_MOTOR_315]);
+	CLEAR_BIT(htim2.Instance->CR1, TIM_CR1_UDIS);
+}
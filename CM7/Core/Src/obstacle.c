@@ -0,0 +1,401 @@
+/*
+ * obstacle.c
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include "obstacle.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "control_loop.h"
+#include "gps.h"
+#include "radar.h"
+#include "stm32h7xx_hal.h"
+
+// Tracking: a return within the gate of a track updates it, otherwise it
+// starts a new one. Tracks not seen for the timeout are dropped.
+#define OBSTACLE_GATE_M            2.5f
+#define OBSTACLE_CONFIRM_HITS      2U
+#define OBSTACLE_TRACK_TIMEOUT_MS  2000U
+#define OBSTACLE_ALPHA             0.4f
+#define OBSTACLE_BETA              0.1f
+#define OBSTACLE_MIN_SCAN_DT_S     0.05f
+#define OBSTACLE_MAX_SPEED_MPS     6.0f
+
+// Planning: below this commanded speed there is nothing to plan. Blocked
+// velocities always score worse than admissible ones. Weight of keeping
+// the last choice against reaching the commanded velocity.
+#define OBSTACLE_MIN_PLAN_MPS      0.1f
+#define OBSTACLE_PLAN_STEP_DEG     15.0f
+#define OBSTACLE_BLOCKED_COST      1000.0f
+#define OBSTACLE_SMOOTH_WEIGHT     2.0f
+// The last choice is remembered this long after avoidance ends, so a
+// return to avoidance passes on the same side
+#define OBSTACLE_CHOICE_HOLD_MS    5000U
+
+ObstacleStatus obstacle_status;
+
+static uint32_t obstacle_scan_ms;
+static bool obstacle_choice_valid;
+static uint32_t obstacle_choice_ms;
+static float obstacle_choice_north;
+static float obstacle_choice_east;
+
+static float Obstacle_LimitSpeed(float *velocity_north, float *velocity_east)
+{
+	float speed = sqrtf((*velocity_north * *velocity_north) + (*velocity_east * *velocity_east));
+
+	if (speed > OBSTACLE_MAX_SPEED_MPS)
+	{
+		*velocity_north *= OBSTACLE_MAX_SPEED_MPS / speed;
+		*velocity_east *= OBSTACLE_MAX_SPEED_MPS / speed;
+		speed = OBSTACLE_MAX_SPEED_MPS;
+	}
+	return speed;
+}
+
+// Boat position in the local frame
+static void Obstacle_BoatPosition(float *north, float *east)
+{
+	GPS_CalculateOffsetMeters(obstacle_status.origin_lat, obstacle_status.origin_lon,
+							  GPS_Data.world_position_avg.N, GPS_Data.world_position_avg.E,
+							  north, east);
+}
+
+static void Obstacle_StartTrack(float north, float east, float bearing_rad,
+								float range_rate_mps, uint32_t now_ms)
+{
+	uint8_t slot = 0U;
+
+	// A free slot, or else the track seen longest ago
+	for (uint8_t i = 0U; i < OBSTACLE_MAX_TRACKS; i++)
+	{
+		if (!obstacle_status.track[i].active)
+		{
+			slot = i;
+			break;
+		}
+		if (obstacle_status.track[i].last_seen_ms < obstacle_status.track[slot].last_seen_ms)
+		{
+			slot = i;
+		}
+	}
+
+	ObstacleTrack *t = &obstacle_status.track[slot];
+
+	// Until a second scan, the range rate is all there is of the motion:
+	// boat velocity plus the range rate along the line of sight.
+	t->active = true;
+	t->confirmed = false;
+	t->hits = 1U;
+	t->north = north;
+	t->east = east;
+	t->velocity_north = (float)GPS_Data.velocity.N + (range_rate_mps * cosf(bearing_rad));
+	t->velocity_east = (float)GPS_Data.velocity.E + (range_rate_mps * sinf(bearing_rad));
+	t->last_seen_ms = now_ms;
+	(void)Obstacle_LimitSpeed(&t->velocity_north, &t->velocity_east);
+}
+
+static void Obstacle_Correct(ObstacleTrack *t, float north, float east, uint32_t now_ms)
+{
+	float dt = (float)(now_ms - t->last_seen_ms) * 0.001f;
+	float rn = north - t->north;
+	float re = east - t->east;
+
+	if (dt < OBSTACLE_MIN_SCAN_DT_S)
+	{
+		dt = OBSTACLE_MIN_SCAN_DT_S;
+	}
+
+	t->north += OBSTACLE_ALPHA * rn;
+	t->east += OBSTACLE_ALPHA * re;
+	t->velocity_north += (OBSTACLE_BETA / dt) * rn;
+	t->velocity_east += (OBSTACLE_BETA / dt) * re;
+	(void)Obstacle_LimitSpeed(&t->velocity_north, &t->velocity_east);
+
+	if (t->hits < OBSTACLE_CONFIRM_HITS)
+	{
+		t->hits++;
+	}
+	t->confirmed = (t->hits >= OBSTACLE_CONFIRM_HITS);
+	t->last_seen_ms = now_ms;
+}
+
+// Nearest-neighbour association, strongest return first
+static void Obstacle_Associate(const RadarTarget *targets, uint8_t count, uint32_t now_ms)
+{
+	bool used[OBSTACLE_MAX_TRACKS] = {false};
+	float boat_north = 0.0f;
+	float boat_east = 0.0f;
+	float heading_deg = (float)GPS_Data.rotation.E;
+
+	Obstacle_BoatPosition(&boat_north, &boat_east);
+
+	for (uint8_t i = 0U; i < count; i++)
+	{
+		// Radar angle is + to port (counter-clockwise), the sense the old
+		// turn-away rule assumed, so it comes off the heading
+		float bearing = (heading_deg - targets[i].angle_deg) * GPS_DEG_TO_RAD;
+		float north = boat_north + (targets[i].distance * cosf(bearing));
+		float east = boat_east + (targets[i].distance * sinf(bearing));
+		int8_t best = -1;
+		float best_d2 = OBSTACLE_GATE_M * OBSTACLE_GATE_M;
+
+		for (uint8_t j = 0U; j < OBSTACLE_MAX_TRACKS; j++)
+		{
+			const ObstacleTrack *t = &obstacle_status.track[j];
+			if (!t->active || used[j])
+			{
+				continue;
+			}
+
+			float dn = north - t->north;
+			float de = east - t->east;
+			float d2 = (dn * dn) + (de * de);
+			if (d2 < best_d2)
+			{
+				best_d2 = d2;
+				best = (int8_t)j;
+			}
+		}
+
+		if (best >= 0)
+		{
+			Obstacle_Correct(&obstacle_status.track[best], north, east, now_ms);
+			used[best] = true;
+		}
+		else
+		{
+			Obstacle_StartTrack(north, east, bearing, targets[i].velocity_mps, now_ms);
+		}
+	}
+}
+
+void Obstacle_Update(void)
+{
+	RadarTarget targets[RADAR_MAX_TARGETS];
+	uint8_t count = 0U;
+	uint32_t scan_ms = 0U;
+	uint32_t now_ms = HAL_GetTick();
+	bool any_active = false;
+
+	if (!radar_detections.radar_state)
+	{
+		memset(obstacle_status.track, 0, sizeof(obstacle_status.track));
+	}
+
+	for (uint8_t i = 0U; i < OBSTACLE_MAX_TRACKS; i++)
+	{
+		ObstacleTrack *t = &obstacle_status.track[i];
+		if (!t->active)
+		{
+			continue;
+		}
+		if ((now_ms - t->last_seen_ms) > OBSTACLE_TRACK_TIMEOUT_MS)
+		{
+			t->active = false;
+			continue;
+		}
+		t->north += CONTROL_LOOP_DT_S * t->velocity_north;
+		t->east += CONTROL_LOOP_DT_S * t->velocity_east;
+		any_active = true;
+	}
+
+	// With nothing tracked, keep the local frame on the boat
+	if (!any_active)
+	{
+		obstacle_status.origin_lat = GPS_Data.world_position_avg.N;
+		obstacle_status.origin_lon = GPS_Data.world_position_avg.E;
+	}
+
+	if (!radar_detections.radar_state)
+	{
+		return;
+	}
+
+	// Targets are written by the USB interrupt
+	taskENTER_CRITICAL();
+	scan_ms = radar_last_update_ms;
+	if (scan_ms != obstacle_scan_ms)
+	{
+		count = radar_target_count;
+		memcpy(targets, radar_targets, sizeof(targets));
+	}
+	taskEXIT_CRITICAL();
+
+	if (scan_ms == obstacle_scan_ms)
+	{
+		return;
+	}
+	obstacle_scan_ms = scan_ms;
+
+	Obstacle_Associate(targets, count, now_ms);
+}
+
+/*
+ * Time until the boat, holding velocity (vn, ve) from (bn, be), first comes
+ * within OBSTACLE_CLEARANCE_M of a confirmed track, up to OBSTACLE_HORIZON_S.
+ * Zero if already inside and closing.
+ */
+static float Obstacle_TimeToContact(float bn, float be, float vn, float ve)
+{
+	float first = OBSTACLE_HORIZON_S;
+
+	for (uint8_t i = 0U; i < OBSTACLE_MAX_TRACKS; i++)
+	{
+		const ObstacleTrack *t = &obstacle_status.track[i];
+		if (!t->active || !t->confirmed)
+		{
+			continue;
+		}
+
+		// Relative position p and velocity w; contact where |p - w t| = R
+		float pn = t->north - bn;
+		float pe = t->east - be;
+		float wn = vn - t->velocity_north;
+		float we = ve - t->velocity_east;
+		float b = (pn * wn) + (pe * we);
+		float c = (pn * pn) + (pe * pe) - (OBSTACLE_CLEARANCE_M * OBSTACLE_CLEARANCE_M);
+
+		if (b <= 0.0f)
+		{
+			continue; // opening
+		}
+		if (c <= 0.0f)
+		{
+			return 0.0f;
+		}
+
+		float a = (wn * wn) + (we * we);
+		float disc = (b * b) - (a * c);
+		if (disc < 0.0f)
+		{
+			continue; // passes clear
+		}
+
+		float contact = (b - sqrtf(disc)) / a;
+		if (contact < first)
+		{
+			first = contact;
+		}
+	}
+	return first;
+}
+
+// One planning pass: the candidate scoring lowest so far
+typedef struct
+{
+	float boat_north;
+	float boat_east;
+	float preferred_north;
+	float preferred_east;
+	float speed;
+	float best_score;
+	float best_north;
+	float best_east;
+} ObstaclePlan;
+
+/*
+ * Score a candidate velocity: squared distance from the commanded velocity
+ * and, weighted, from the last choice, both relative to the commanded
+ * speed. A candidate reaching contact within the horizon scores above every
+ * admissible one, less badly the later the contact.
+ */
+static void Obstacle_Consider(ObstaclePlan *plan, float vn, float ve)
+{
+	float dn = vn - plan->preferred_north;
+	float de = ve - plan->preferred_east;
+	float score = ((dn * dn) + (de * de)) / (plan->speed * plan->speed);
+
+	if (obstacle_choice_valid)
+	{
+		float kn = vn - obstacle_choice_north;
+		float ke = ve - obstacle_choice_east;
+		score += OBSTACLE_SMOOTH_WEIGHT * ((kn * kn) + (ke * ke)) / (plan->speed * plan->speed);
+	}
+
+	float contact = Obstacle_TimeToContact(plan->boat_north, plan->boat_east, vn, ve);
+	if (contact < OBSTACLE_HORIZON_S)
+	{
+		score = OBSTACLE_BLOCKED_COST + (OBSTACLE_HORIZON_S - contact);
+	}
+
+	if (score < plan->best_score)
+	{
+		plan->best_score = score;
+		plan->best_north = vn;
+		plan->best_east = ve;
+	}
+}
+
+bool Obstacle_PlanVelocity(float preferred_north, float preferred_east,
+						   float *chosen_north, float *chosen_east)
+{
+	uint32_t start = DWT->CYCCNT;
+	ObstaclePlan plan;
+
+	plan.preferred_north = preferred_north;
+	plan.preferred_east = preferred_east;
+	plan.speed = sqrtf((preferred_north * preferred_north) + (preferred_east * preferred_east));
+	plan.best_score = INFINITY;
+	plan.best_north = preferred_north;
+	plan.best_east = preferred_east;
+	Obstacle_BoatPosition(&plan.boat_north, &plan.boat_east);
+
+	if ((plan.speed < OBSTACLE_MIN_PLAN_MPS)
+		|| (Obstacle_TimeToContact(plan.boat_north, plan.boat_east, preferred_north, preferred_east) >= OBSTACLE_HORIZON_S))
+	{
+		obstacle_status.avoiding = false;
+		if ((HAL_GetTick() - obstacle_choice_ms) > OBSTACLE_CHOICE_HOLD_MS)
+		{
+			obstacle_choice_valid = false;
+		}
+	}
+	else
+	{
+		float heading = atan2f(preferred_east, preferred_north);
+
+		for (uint8_t h = 0U; h < OBSTACLE_PLAN_HEADINGS; h++)
+		{
+			float offset_deg = ((float)h - (0.5f * (float)(OBSTACLE_PLAN_HEADINGS - 1U))) * OBSTACLE_PLAN_STEP_DEG;
+			float direction = heading + (offset_deg * GPS_DEG_TO_RAD);
+			float cn = cosf(direction);
+			float ce = sinf(direction);
+
+			for (uint8_t s = 0U; s < OBSTACLE_PLAN_SPEEDS; s++)
+			{
+				float v = plan.speed * (float)(OBSTACLE_PLAN_SPEEDS - s) / (float)OBSTACLE_PLAN_SPEEDS;
+				Obstacle_Consider(&plan, v * cn, v * ce);
+			}
+		}
+
+		// Stop, and the last choice: the samples turn with the boat, so
+		// without it the choice would step between neighbouring samples
+		Obstacle_Consider(&plan, 0.0f, 0.0f);
+		if (obstacle_choice_valid)
+		{
+			Obstacle_Consider(&plan, obstacle_choice_north, obstacle_choice_east);
+		}
+
+		obstacle_status.avoiding = true;
+		obstacle_choice_valid = true;
+		obstacle_choice_ms = HAL_GetTick();
+		obstacle_choice_north = plan.best_north;
+		obstacle_choice_east = plan.best_east;
+	}
+
+	*chosen_north = plan.best_north;
+	*chosen_east = plan.best_east;
+
+	obstacle_status.plan_cycles_last = DWT->CYCCNT - start;
+	if (obstacle_status.plan_cycles_last > obstacle_status.plan_cycles_max)
+	{
+		obstacle_status.plan_cycles_max = obstacle_status.plan_cycles_last;
+	}
+
+	return obstacle_status.avoiding;
+}
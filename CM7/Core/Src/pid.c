@@ -0,0 +1,94 @@
+/*
+ * pid.c
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include "pid.h"
+
+#include <stddef.h>
+
+static float PID_Clamp(float value, float min, float max)
+{
+	if (value < min)
+	{
+		return min;
+	}
+	if (value > max)
+	{
+		return max;
+	}
+	return value;
+}
+
+void PID_Init(PID_t *pid, float kp, float ki, float kd, float dt_s, float d_filter_tau_s,
+			  float out_min, float out_max)
+{
+	if (pid == NULL)
+	{
+		return;
+	}
+
+	pid->kp = kp;
+	pid->ki = ki;
+	pid->kd = kd;
+	pid->dt_s = dt_s;
+	pid->d_filter_tau_s = d_filter_tau_s;
+	pid->out_min = out_min;
+	pid->out_max = out_max;
+
+	PID_Reset(pid);
+}
+
+void PID_Reset(PID_t *pid)
+{
+	if (pid == NULL)
+	{
+		return;
+	}
+
+	pid->integrator = 0.0f;
+	pid->prev_error = 0.0f;
+	pid->derivative = 0.0f;
+	pid->initialized = false;
+}
+
+float PID_Update(PID_t *pid, float error)
+{
+	if ((pid == NULL) || (pid->dt_s <= 0.0f))
+	{
+		return 0.0f;
+	}
+
+	// No derivative on the first step, so a reset does not kick the output.
+	if (!pid->initialized)
+	{
+		pid->prev_error = error;
+		pid->derivative = 0.0f;
+		pid->initialized = true;
+	}
+
+	// First-order low-pass on the error rate: GNSS updates are slower than
+	// the control loop, so the raw difference is a train of spikes.
+	float raw_derivative = (error - pid->prev_error) / pid->dt_s;
+	float alpha = pid->dt_s / (pid->d_filter_tau_s + pid->dt_s);
+	pid->derivative += alpha * (raw_derivative - pid->derivative);
+	pid->prev_error = error;
+
+	float p_term = pid->kp * error;
+	float d_term = pid->kd * pid->derivative;
+	float unclamped = p_term + pid->integrator + d_term;
+
+	// Conditional integration anti-windup.
+	float integ_step = pid->ki * error * pid->dt_s;
+	bool saturated_high = (unclamped >= pid->out_max) && (integ_step > 0.0f);
+	bool saturated_low = (unclamped <= pid->out_min) && (integ_step < 0.0f);
+
+	if (!saturated_high && !saturated_low)
+	{
+		pid->integrator += integ_step;
+		pid->integrator = PID_Clamp(pid->integrator, pid->out_min, pid->out_max);
+	}
+
+	return PID_Clamp(p_term + pid->integrator + d_term, pid->out_min, pid->out_max);
+}
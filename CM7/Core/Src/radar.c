@@ -11,25 +11,254 @@
 
  #include "radar.h"
 #include "usbd_cdc.h"
+#include "usbd_cdc_if.h"
+#include "usart.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <stdio.h>
+#include <string.h>
 
  RadarData radar_detections;
+ RadarTarget radar_targets[RADAR_MAX_TARGETS];
+ uint8_t radar_target_count;
+ RadarRangeProfile radar_profile;
+ RadarParamRequest radar_param_request;
+ RadarParamReply radar_param_reply;
  bool radar_task_update;
  uint32_t radar_last_update_ms;
 
+ static uint8_t radar_param_tx_buffer[UART4_DMA_CACHE_ALIGN_UP(RADAR_PARAM_ESP32_TX_LEN)] __attribute__((aligned(UART4_DMA_CACHE_LINE_SIZE)));
+ // CDC_Transmit_FS keeps the pointer until the IN transfer completes.
+ static uint8_t radar_param_usb_buffer[32];
 
- void usb_radar_rx(uint8_t *buf)
+ extern USBD_HandleTypeDef hUsbDeviceFS;
+
+ static char radar_rx_line[RADAR_RX_LINE_MAX];
+ static uint32_t radar_rx_line_len;
+ static bool radar_rx_line_overflow;
+
+
+ static int usb_radar_hex_nibble(char c)
+ {
+	if ((c >= '0') && (c <= '9'))
+	{
+		return c - '0';
+	}
+	if ((c >= 'a') && (c <= 'f'))
+	{
+		return c - 'a' + 10;
+	}
+	if ((c >= 'A') && (c <= 'F'))
+	{
+		return c - 'A' + 10;
+	}
+	return -1;
+ }
+
+ /*
+  * Range profile line:
+  *   #P,seq,floor_half_db,start_cm,step_cm,HEX
+  * HEX holds one level per bin (first as uint8, the rest as int8 deltas) and
+  * then one int8 angle per bin.
+  */
+ static void usb_radar_parse_profile(const char *line)
+ {
+	unsigned int seq;
+	int floor_half_db;
+	int start_cm;
+	int step_cm;
+	int hex_start = 0;
+
+	if (sscanf(line, "#P,%u,%d,%d,%d,%n", &seq, &floor_half_db, &start_cm, &step_cm, &hex_start) < 4)
+	{
+		return;
+	}
+
+	if (hex_start == 0)
+	{
+		return;
+	}
+
+	const char *hex = line + hex_start;
+	size_t hex_len = strlen(hex);
+	uint32_t bytes = hex_len / 2U;
+
+	// Two bytes (level, angle) per bin.
+	if (((hex_len % 4U) != 0U) || (bytes == 0U) || ((bytes / 2U) > RADAR_PROFILE_MAX_BINS))
+	{
+		return;
+	}
+
+	uint8_t bins = (uint8_t)(bytes / 2U);
+	uint8_t payload[2U * RADAR_PROFILE_MAX_BINS];
+
+	for (uint32_t i = 0U; i < bytes; i++)
+	{
+		int hi = usb_radar_hex_nibble(hex[2U * i]);
+		int lo = usb_radar_hex_nibble(hex[(2U * i) + 1U]);
+
+		if ((hi < 0) || (lo < 0))
+		{
+			return;
+		}
+
+		payload[i] = (uint8_t)((hi << 4) | lo);
+	}
+
+	int32_t level = payload[0];
+
+	for (uint8_t k = 0U; k < bins; k++)
+	{
+		if (k > 0U)
+		{
+			level += (int8_t)payload[k];
+		}
+
+		if (level < 0)
+		{
+			level = 0;
+		}
+		else if (level > 255)
+		{
+			level = 255;
+		}
+
+		radar_profile.level[k] = (uint8_t)level;
+		radar_profile.angle_deg[k] = (int8_t)payload[bins + k];
+	}
+
+	radar_profile.seq = (uint16_t)seq;
+	radar_profile.bins = bins;
+	radar_profile.floor_db = 0.5f * (float)floor_half_db;
+	radar_profile.start_m = 0.01f * (float)start_cm;
+	radar_profile.step_m = 0.01f * (float)step_cm;
+	radar_profile.update_ms = HAL_GetTick();
+ }
+
+ /*
+  * Parameter answer line:
+  *   #V,id,value,status
+  */
+ static void usb_radar_parse_param(const char *line)
  {
-	  int r = sscanf(buf, "%f,%f,%f", &radar_detections.distance, &radar_detections.angle_deg, &radar_detections.quality);
+	unsigned int id;
+	float value;
+	unsigned int status;
 
-	if (r < 1)
+	if (sscanf(line, "#V,%u,%f,%u", &id, &value, &status) < 3)
+	{
+		return;
+	}
+
+	radar_param_reply.id = (uint8_t)id;
+	radar_param_reply.value = value;
+	radar_param_reply.status = (uint8_t)status;
+	radar_param_reply.pending = true;
+ }
+
+ /*
+  * One packet from the Pi, strongest target first:
+  *   range,angle,quality,velocity;range,angle,quality,velocity
+  * Older scripts send range,angle,quality for a single target.
+  */
+ static void usb_radar_parse_line(const char *line)
+ {
+	uint8_t count = 0U;
+	const char *p = line;
+
+	// '#' lines are side channels from the Pi, not detections.
+	if (line[0] == '#')
+	{
+		if (line[1] == 'P')
+		{
+			usb_radar_parse_profile(line);
+		}
+		else if (line[1] == 'V')
+		{
+			usb_radar_parse_param(line);
+		}
+		return;
+	}
+
+	while ((p != NULL) && (count < RADAR_MAX_TARGETS))
+	{
+		RadarTarget target = {0};
+		int r = sscanf(p, "%f,%f,%f,%f", &target.distance, &target.angle_deg,
+				&target.quality, &target.velocity_mps);
+
+		if (r < 1)
+		{
+			break;
+		}
+
+		// A range of zero is the Pi's "no detection" group.
+		if (target.distance > 0.0f)
+		{
+			radar_targets[count] = target;
+			count++;
+		}
+
+		p = strchr(p, ';');
+		if (p != NULL)
+		{
+			p++;
+		}
+	}
+
+	if ((count == 0U) && (p == line))
 	{
 		radar_task_update = false;
 		return;
 	}
 
+	radar_target_count = count;
+
+	if (count > 0U)
+	{
+		radar_detections.distance = radar_targets[0].distance;
+		radar_detections.angle_deg = radar_targets[0].angle_deg;
+		radar_detections.quality = radar_targets[0].quality;
+		radar_detections.velocity_mps = radar_targets[0].velocity_mps;
+	}
+	else
+	{
+		radar_detections.distance = 0.0f;
+		radar_detections.angle_deg = 0.0f;
+		radar_detections.quality = 0.0f;
+		radar_detections.velocity_mps = 0.0f;
+	}
+
 	radar_last_update_ms = HAL_GetTick();
+ }
+
+ // Packets can span several USB transfers, so assemble full lines first.
+ void usb_radar_rx(uint8_t *buf, uint32_t len)
+ {
+	for (uint32_t i = 0U; i < len; i++)
+	{
+		char c = (char)buf[i];
 
-	  return;
+		if ((c == '\n') || (c == '\r'))
+		{
+			if ((radar_rx_line_len > 0U) && !radar_rx_line_overflow)
+			{
+				radar_rx_line[radar_rx_line_len] = '\0';
+				usb_radar_parse_line(radar_rx_line);
+			}
+
+			radar_rx_line_len = 0U;
+			radar_rx_line_overflow = false;
+		}
+		else if (radar_rx_line_len < (RADAR_RX_LINE_MAX - 1U))
+		{
+			radar_rx_line[radar_rx_line_len++] = c;
+		}
+		else
+		{
+			// Drop the rest of an oversized line.
+			radar_rx_line_overflow = true;
+		}
+	}
  }
 
  void usb_radar_tx_state()
@@ -47,4 +276,83 @@
 	clear_buffer((byte *)buffer, sizeof(buffer));
  }
 
+ // Forward a pending parameter request from the ESP32 to the Pi.
+ void usb_radar_tx_param(void)
+ {
+	USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef *)hUsbDeviceFS.pClassData;
+	RadarParamRequest request;
+	int tx_size;
 
+	// The buffer may still be going out; keep the request until it has.
+	if ((hcdc == NULL) || (hcdc->TxState != 0U))
+	{
+		return;
+	}
+
+	// The USART6 interrupt writes the request; take it whole.
+	taskENTER_CRITICAL();
+	request.pending = radar_param_request.pending;
+	request.op = radar_param_request.op;
+	request.id = radar_param_request.id;
+	request.value = radar_param_request.value;
+	radar_param_request.pending = false;
+	taskEXIT_CRITICAL();
+
+	if (!request.pending)
+	{
+		return;
+	}
+
+	if (request.op == RADAR_PARAM_OP_SET)
+	{
+		tx_size = snprintf((char *)radar_param_usb_buffer, sizeof(radar_param_usb_buffer), "#S,%u,%.6g\r\n",
+				request.id, (double)request.value);
+	}
+	else
+	{
+		tx_size = snprintf((char *)radar_param_usb_buffer, sizeof(radar_param_usb_buffer), "#G,%u\r\n", request.id);
+	}
+
+	if (CDC_Transmit_FS(radar_param_usb_buffer, (uint16_t)tx_size) != USBD_OK)
+	{
+		// Try again next time, unless a newer request has come in.
+		taskENTER_CRITICAL();
+		if (!radar_param_request.pending)
+		{
+			radar_param_request.op = request.op;
+			radar_param_request.id = request.id;
+			radar_param_request.value = request.value;
+			radar_param_request.pending = true;
+		}
+		taskEXIT_CRITICAL();
+	}
+ }
+
+ // Send the Pi's last parameter answer to the ESP32. USART6 TX is shared with
+ // the GPS frames, so the reply waits until the line is free.
+ void usart6_radar_tx_param_reply(void)
+ {
+	if (!radar_param_reply.pending || !USART6_ClaimTx())
+	{
+		return;
+	}
+
+	uint8_t *p = radar_param_tx_buffer;
+
+	*p++ = RADAR_PARAM_ESP32_START;
+	*p++ = radar_param_reply.id;
+	memcpy(p, &radar_param_reply.value, 4); p += 4;
+	*p++ = radar_param_reply.status;
+	*p++ = 0U;
+
+	SCB_CleanDCache_by_Addr((uint32_t *)radar_param_tx_buffer, sizeof(radar_param_tx_buffer));
+
+	if (HAL_UART_Transmit_DMA(&huart6, radar_param_tx_buffer, RADAR_PARAM_ESP32_TX_LEN) == HAL_OK)
+	{
+		radar_param_reply.pending = false;
+	}
+	else
+	{
+		usart6_tx_complete = true;
+	}
+ }
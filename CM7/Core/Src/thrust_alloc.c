@@ -0,0 +1,168 @@
+/*
+ * thrust_alloc.c
+ *
+ *  Created on: Oct 19, 2026
+ *
+ *  Thruster layout (body wrench from each motor):
+ *    45:  back,    left,  counter-clockwise
+ *    135: forward, left,  clockwise
+ *    225: forward, right, counter-clockwise
+ *    315: back,    right, clockwise
+ *  which matches the motor pairs the modes have always used:
+ *    forward 135 + 225, reverse 45 + 315, left 45 + 135, right 225 + 315,
+ *    counter-clockwise 45 + 225, clockwise 135 + 315.
+ */
+
+#include "thrust_alloc.h"
+
+#include <stddef.h>
+
+#define THRUST_ALLOC_AXES 3U
+
+// Wrench = B * thrust, rows surge / sway / yaw, columns 45 / 135 / 225 / 315.
+static const float thrust_alloc_B[THRUST_ALLOC_AXES][THRUST_ALLOC_MOTORS] =
+{
+	{ -0.5f,  0.5f,  0.5f, -0.5f },
+	{ -0.5f, -0.5f,  0.5f,  0.5f },
+	{ -0.5f,  0.5f, -0.5f,  0.5f },
+};
+
+// Pseudo-inverse of B. The rows of B are orthonormal, so it is B transposed.
+static const float thrust_alloc_B_pinv[THRUST_ALLOC_MOTORS][THRUST_ALLOC_AXES] =
+{
+	{ -0.5f, -0.5f, -0.5f },
+	{  0.5f, -0.5f,  0.5f },
+	{  0.5f,  0.5f, -0.5f },
+	{ -0.5f,  0.5f,  0.5f },
+};
+
+// Saturation priority: yaw, then sway, then surge.
+static const uint8_t thrust_alloc_priority[THRUST_ALLOC_AXES] = { 2U, 1U, 0U };
+
+/*
+ * Largest k in [0, 1] such that f + k * b still fits in one unit of thrust
+ * span. Thrust [1, 1, 1, 1] produces no wrench, so any f whose max - min is
+ * at most 1 can be shifted into [0, 1] without changing the wrench.
+ */
+static float ThrustAlloc_MaxScale(const float f[THRUST_ALLOC_MOTORS], const float b[THRUST_ALLOC_MOTORS])
+{
+	float k = 1.0f;
+
+	for (uint32_t i = 0U; i < THRUST_ALLOC_MOTORS; i++)
+	{
+		for (uint32_t j = 0U; j < THRUST_ALLOC_MOTORS; j++)
+		{
+			float db = b[i] - b[j];
+
+			if (db > 0.0f)
+			{
+				float k_ij = (1.0f - (f[i] - f[j])) / db;
+				if (k_ij < k)
+				{
+					k = k_ij;
+				}
+			}
+		}
+	}
+
+	return (k > 0.0f) ? k : 0.0f;
+}
+
+bool ThrustAlloc_Solve(const ThrustWrench *desired, float thrust[THRUST_ALLOC_MOTORS],
+					   ThrustWrench *achieved)
+{
+	float f[THRUST_ALLOC_MOTORS] = {0.0f};
+	bool saturated = false;
+
+	if ((desired == NULL) || (thrust == NULL))
+	{
+		return false;
+	}
+
+	const float w[THRUST_ALLOC_AXES] = { desired->surge, desired->sway, desired->yaw };
+
+	// Add one axis at a time in priority order, scaling it down only as far
+	// as the thrusters allow given the axes already placed.
+	for (uint32_t p = 0U; p < THRUST_ALLOC_AXES; p++)
+	{
+		uint8_t axis = thrust_alloc_priority[p];
+		float b[THRUST_ALLOC_MOTORS];
+
+		if (w[axis] == 0.0f)
+		{
+			continue;
+		}
+
+		for (uint32_t i = 0U; i < THRUST_ALLOC_MOTORS; i++)
+		{
+			b[i] = thrust_alloc_B_pinv[i][axis] * w[axis];
+		}
+
+		float k = ThrustAlloc_MaxScale(f, b);
+		if (k < 1.0f)
+		{
+			saturated = true;
+		}
+
+		for (uint32_t i = 0U; i < THRUST_ALLOC_MOTORS; i++)
+		{
+			f[i] += k * b[i];
+		}
+	}
+
+	// Null-space shift: the lowest motor goes to zero, so thrust is
+	// one-directional and no pair of opposing motors fights each other.
+	float f_min = f[0];
+	for (uint32_t i = 1U; i < THRUST_ALLOC_MOTORS; i++)
+	{
+		if (f[i] < f_min)
+		{
+			f_min = f[i];
+		}
+	}
+
+	for (uint32_t i = 0U; i < THRUST_ALLOC_MOTORS; i++)
+	{
+		float t = f[i] - f_min;
+
+		if (t < THRUST_ALLOC_MIN_THRUST)
+		{
+			t = 0.0f;
+		}
+		else if (t > 1.0f)
+		{
+			t = 1.0f;
+		}
+
+		thrust[i] = t;
+	}
+
+	if (achieved != NULL)
+	{
+		ThrustAlloc_Forward(thrust, achieved);
+	}
+
+	return saturated;
+}
+
+void ThrustAlloc_Forward(const float thrust[THRUST_ALLOC_MOTORS], ThrustWrench *wrench)
+{
+	float w[THRUST_ALLOC_AXES] = {0.0f};
+
+	if ((thrust == NULL) || (wrench == NULL))
+	{
+		return;
+	}
+
+	for (uint32_t a = 0U; a < THRUST_ALLOC_AXES; a++)
+	{
+		for (uint32_t i = 0U; i < THRUST_ALLOC_MOTORS; i++)
+		{
+			w[a] += thrust_alloc_B[a][i] * thrust[i];
+		}
+	}
+
+	wrench->surge = w[0];
+	wrench->sway = w[1];
+	wrench->yaw = w[2];
+}
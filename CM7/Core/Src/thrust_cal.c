@@ -0,0 +1,404 @@
+/*
+ * thrust_cal.c
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include "thrust_cal.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "control_loop.h"
+#include "stm32h7xx_hal.h"
+
+// Last 128 KB sector of bank 1, reserved in STM32H755ZITX_FLASH.ld. Erasing
+// it stalls instruction fetch from bank 1, so it is only written with the
+// motors stopped at the end of a calibration.
+#define THRUST_CAL_FLASH_ADDR        0x080E0000UL
+#define THRUST_CAL_FLASH_SECTOR      FLASH_SECTOR_7
+
+#define THRUST_CAL_MAGIC             0x54434C42UL // "TCLB"
+#define THRUST_CAL_VERSION           1UL
+
+// Nominal model used until a calibration is saved: thrust is linear in the
+// command above a deadband of 63 (what Motor_MapSpeed0_100_to_PWM assumes).
+#define THRUST_CAL_NOMINAL_MIN_CMD   63U
+
+// Sweep timing. A full sweep takes about
+// 4 * (REST + 17 * (SETTLE + MEASURE)) = 10 minutes.
+#define THRUST_CAL_SETTLE_S          4U
+#define THRUST_CAL_MEASURE_S         4U
+#define THRUST_CAL_REST_S            10U
+
+// Yaw rates below this (deg/s, after removing the baseline) are treated as
+// no thrust. Sets each motor's start point.
+#define THRUST_CAL_NOISE_DEG_S       2.0f
+
+#define THRUST_CAL_TICKS(s)          ((s) * CONTROL_LOOP_RATE_HZ)
+
+// Flash is programmed in 256-bit words
+#define THRUST_CAL_FLASH_WORD_BYTES  (FLASH_NB_32BITWORD_IN_FLASHWORD * 4U)
+#define THRUST_CAL_FLASH_BYTES       (((sizeof(ThrustCalTable) + THRUST_CAL_FLASH_WORD_BYTES - 1U) \
+									   / THRUST_CAL_FLASH_WORD_BYTES) * THRUST_CAL_FLASH_WORD_BYTES)
+
+typedef enum
+{
+	SWEEP_REST = 0,
+	SWEEP_SETTLE,
+	SWEEP_MEASURE
+} SweepPhase;
+
+ThrustCalStatus thrust_cal_status = THRUST_CAL_DEFAULT;
+ThrustCalTable thrust_cal_table;
+ThrustCalSweep thrust_cal_sweep;
+
+static SweepPhase sweep_phase;
+
+static uint32_t ThrustCal_Checksum(const ThrustCalTable *table)
+{
+	// FNV-1a over everything but the checksum itself
+	const uint8_t *bytes = (const uint8_t *)table;
+	uint32_t hash = 2166136261UL;
+
+	for (uint32_t i = 0U; i < offsetof(ThrustCalTable, checksum); i++)
+	{
+		hash ^= bytes[i];
+		hash *= 16777619UL;
+	}
+	return hash;
+}
+
+static void ThrustCal_SetNominal(ThrustCalTable *table)
+{
+	memset(table, 0, sizeof(*table));
+	table->magic = THRUST_CAL_MAGIC;
+	table->version = THRUST_CAL_VERSION;
+
+	for (uint32_t m = 0U; m < THRUST_ALLOC_MOTORS; m++)
+	{
+		for (uint32_t j = 0U; j < THRUST_CAL_POINTS; j++)
+		{
+			float t = (float)j / (float)(THRUST_CAL_POINTS - 1U);
+			float cmd = (float)THRUST_CAL_NOMINAL_MIN_CMD
+				+ (t * (float)(255U - THRUST_CAL_NOMINAL_MIN_CMD)) + 0.5f;
+			table->cmd[m][j] = (uint8_t)cmd;
+		}
+	}
+	table->checksum = ThrustCal_Checksum(table);
+}
+
+static bool ThrustCal_IsValid(const ThrustCalTable *table)
+{
+	if ((table->magic != THRUST_CAL_MAGIC) || (table->version != THRUST_CAL_VERSION)
+		|| (table->checksum != ThrustCal_Checksum(table)))
+	{
+		return false;
+	}
+
+	// Tables must be non-decreasing or the controllers see a sign flip
+	for (uint32_t m = 0U; m < THRUST_ALLOC_MOTORS; m++)
+	{
+		for (uint32_t j = 1U; j < THRUST_CAL_POINTS; j++)
+		{
+			if (table->cmd[m][j] < table->cmd[m][j - 1U])
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static bool ThrustCal_WriteFlash(const ThrustCalTable *table)
+{
+	static uint32_t flash_buf[THRUST_CAL_FLASH_BYTES / 4U] __attribute__((aligned(32)));
+	FLASH_EraseInitTypeDef erase = {0};
+	uint32_t sector_error = 0U;
+	HAL_StatusTypeDef status;
+
+	memset(flash_buf, 0xFF, sizeof(flash_buf));
+	memcpy(flash_buf, table, sizeof(*table));
+
+	erase.TypeErase = FLASH_TYPEERASE_SECTORS;
+	erase.Banks = FLASH_BANK_1;
+	erase.Sector = THRUST_CAL_FLASH_SECTOR;
+	erase.NbSectors = 1U;
+	erase.VoltageRange = FLASH_VOLTAGE_RANGE_3;
+
+	HAL_FLASH_Unlock();
+	status = HAL_FLASHEx_Erase(&erase, &sector_error);
+
+	for (uint32_t offset = 0U; (status == HAL_OK) && (offset < THRUST_CAL_FLASH_BYTES);
+		 offset += THRUST_CAL_FLASH_WORD_BYTES)
+	{
+		status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_FLASHWORD, THRUST_CAL_FLASH_ADDR + offset,
+								   (uint32_t)&flash_buf[offset / 4U]);
+	}
+	HAL_FLASH_Lock();
+
+	// Drop any stale copy of the sector from the data cache before verifying
+	SCB_InvalidateDCache_by_Addr((uint32_t *)THRUST_CAL_FLASH_ADDR, (int32_t)THRUST_CAL_FLASH_BYTES);
+
+	return (status == HAL_OK)
+		&& (memcmp((const void *)THRUST_CAL_FLASH_ADDR, table, sizeof(*table)) == 0);
+}
+
+void ThrustCal_Init(void)
+{
+	const ThrustCalTable *stored = (const ThrustCalTable *)THRUST_CAL_FLASH_ADDR;
+
+	if (ThrustCal_IsValid(stored))
+	{
+		memcpy(&thrust_cal_table, stored, sizeof(thrust_cal_table));
+		thrust_cal_status = THRUST_CAL_LOADED;
+	}
+	else
+	{
+		ThrustCal_SetNominal(&thrust_cal_table);
+		thrust_cal_status = THRUST_CAL_DEFAULT;
+	}
+}
+
+uint8_t ThrustCal_ThrustToCmd(uint8_t motor, float thrust)
+{
+	if ((motor >= THRUST_ALLOC_MOTORS) || !(thrust > 0.0f))
+	{
+		return 0U;
+	}
+
+	const uint8_t *cmd = thrust_cal_table.cmd[motor];
+	float x = thrust * (float)(THRUST_CAL_POINTS - 1U);
+	uint32_t i = (uint32_t)x;
+
+	if (i >= (THRUST_CAL_POINTS - 1U))
+	{
+		return cmd[THRUST_CAL_POINTS - 1U];
+	}
+
+	float frac = x - (float)i;
+	float out = (float)cmd[i] + (frac * (float)(cmd[i + 1U] - cmd[i])) + 0.5f;
+	return (uint8_t)out;
+}
+
+static uint8_t ThrustCal_SweepCmd(uint8_t step)
+{
+	if (step == 0U)
+	{
+		return 0U;
+	}
+	return (uint8_t)(THRUST_CAL_SWEEP_MIN_CMD
+		+ (((uint32_t)(step - 1U) * (255U - THRUST_CAL_SWEEP_MIN_CMD)) / (THRUST_CAL_SWEEP_STEPS - 2U)));
+}
+
+void ThrustCal_Start(void)
+{
+	memset(&thrust_cal_sweep, 0, sizeof(thrust_cal_sweep));
+	sweep_phase = SWEEP_REST;
+	thrust_cal_status = THRUST_CAL_RUNNING;
+}
+
+/*
+ * Build the table for one motor from its sweep. Returns the full-command
+ * thrust proxy (rate squared), or 0 if the motor never left the noise.
+ */
+static float ThrustCal_MotorResponse(uint8_t motor, float proxy[THRUST_CAL_SWEEP_STEPS])
+{
+	const float *rate = thrust_cal_sweep.yaw_rate_deg_s[motor];
+	float noise = THRUST_CAL_NOISE_DEG_S * THRUST_CAL_NOISE_DEG_S;
+	float running_max = 0.0f;
+
+	proxy[0] = 0.0f;
+	for (uint32_t k = 1U; k < THRUST_CAL_SWEEP_STEPS; k++)
+	{
+		float r = fabsf(rate[k] - rate[0]);
+		float p = r * r;
+
+		if (p < noise)
+		{
+			p = 0.0f;
+		}
+		// Force a monotonic response; noise must not make the table fold back
+		if (p < running_max)
+		{
+			p = running_max;
+		}
+		running_max = p;
+		proxy[k] = p;
+	}
+	return running_max;
+}
+
+static bool ThrustCal_BuildTable(ThrustCalTable *table)
+{
+	float proxy[THRUST_ALLOC_MOTORS][THRUST_CAL_SWEEP_STEPS];
+	float common_full = 0.0f;
+
+	memset(table, 0, sizeof(*table));
+	table->magic = THRUST_CAL_MAGIC;
+	table->version = THRUST_CAL_VERSION;
+
+	for (uint8_t m = 0U; m < THRUST_ALLOC_MOTORS; m++)
+	{
+		float full = ThrustCal_MotorResponse(m, proxy[m]);
+		if (full <= 0.0f)
+		{
+			return false;
+		}
+		table->full_response[m] = sqrtf(full);
+		// Thrust 1.0 is what the weakest motor reaches, so every motor can
+		// deliver the whole range and the allocator's pairs stay balanced.
+		if ((m == 0U) || (full < common_full))
+		{
+			common_full = full;
+		}
+	}
+
+	for (uint8_t m = 0U; m < THRUST_ALLOC_MOTORS; m++)
+	{
+		// Start point: the highest command that still gave no thrust
+		uint32_t start = 1U;
+		while (((start + 1U) < THRUST_CAL_SWEEP_STEPS) && (proxy[m][start + 1U] <= 0.0f))
+		{
+			start++;
+		}
+		table->cmd[m][0] = ThrustCal_SweepCmd((uint8_t)start);
+
+		uint32_t k = start + 1U;
+		for (uint32_t j = 1U; j < THRUST_CAL_POINTS; j++)
+		{
+			float target = common_full * (float)j / (float)(THRUST_CAL_POINTS - 1U);
+
+			while ((k < (THRUST_CAL_SWEEP_STEPS - 1U)) && (proxy[m][k] < target))
+			{
+				k++;
+			}
+
+			float lo_p = proxy[m][k - 1U];
+			float hi_p = proxy[m][k];
+			float lo_c = (float)ThrustCal_SweepCmd((uint8_t)(k - 1U));
+			float hi_c = (float)ThrustCal_SweepCmd((uint8_t)k);
+			float frac = (hi_p > lo_p) ? ((target - lo_p) / (hi_p - lo_p)) : 1.0f;
+
+			if (frac < 0.0f)
+			{
+				frac = 0.0f;
+			}
+			else if (frac > 1.0f)
+			{
+				frac = 1.0f;
+			}
+
+			uint8_t cmd = (uint8_t)(lo_c + (frac * (hi_c - lo_c)) + 0.5f);
+			if (cmd < table->cmd[m][j - 1U])
+			{
+				cmd = table->cmd[m][j - 1U];
+			}
+			table->cmd[m][j] = cmd;
+		}
+	}
+
+	table->checksum = ThrustCal_Checksum(table);
+	return true;
+}
+
+static void ThrustCal_Finish(void)
+{
+	ThrustCalTable table;
+
+	if (ThrustCal_BuildTable(&table) && ThrustCal_WriteFlash(&table))
+	{
+		memcpy(&thrust_cal_table, &table, sizeof(thrust_cal_table));
+		thrust_cal_status = THRUST_CAL_DONE;
+	}
+	else
+	{
+		thrust_cal_status = THRUST_CAL_FAILED;
+	}
+}
+
+bool ThrustCal_Step(float heading_deg, uint8_t cmd[THRUST_ALLOC_MOTORS])
+{
+	ThrustCalSweep *sw = &thrust_cal_sweep;
+
+	memset(cmd, 0, THRUST_ALLOC_MOTORS);
+
+	if (thrust_cal_status != THRUST_CAL_RUNNING)
+	{
+		return false;
+	}
+
+	sw->step_ticks++;
+
+	switch (sweep_phase)
+	{
+		case SWEEP_REST:
+			// Let the boat stop turning before the next motor
+			if (sw->step_ticks < THRUST_CAL_TICKS(THRUST_CAL_REST_S))
+			{
+				return true;
+			}
+			if (sw->motor >= THRUST_ALLOC_MOTORS)
+			{
+				// All motors have been off for the whole rest, so the
+				// flash write can stall the core safely.
+				ThrustCal_Finish();
+				return false;
+			}
+			sweep_phase = SWEEP_SETTLE;
+			sw->step = 0U;
+			sw->step_ticks = 0U;
+			return true;
+
+		case SWEEP_SETTLE:
+			cmd[sw->motor] = ThrustCal_SweepCmd(sw->step);
+			if (sw->step_ticks >= THRUST_CAL_TICKS(THRUST_CAL_SETTLE_S))
+			{
+				sweep_phase = SWEEP_MEASURE;
+				sw->step_ticks = 0U;
+				sw->heading_prev_deg = heading_deg;
+				sw->heading_travel_deg = 0.0f;
+			}
+			return true;
+
+		case SWEEP_MEASURE:
+		default:
+		{
+			cmd[sw->motor] = ThrustCal_SweepCmd(sw->step);
+
+			// Unwrapped heading change over the window
+			float delta = heading_deg - sw->heading_prev_deg;
+			if (delta > 180.0f)
+			{
+				delta -= 360.0f;
+			}
+			else if (delta < -180.0f)
+			{
+				delta += 360.0f;
+			}
+			sw->heading_travel_deg += delta;
+			sw->heading_prev_deg = heading_deg;
+
+			if (sw->step_ticks < THRUST_CAL_TICKS(THRUST_CAL_MEASURE_S))
+			{
+				return true;
+			}
+
+			sw->yaw_rate_deg_s[sw->motor][sw->step] = sw->heading_travel_deg / (float)THRUST_CAL_MEASURE_S;
+			sw->step_ticks = 0U;
+			sweep_phase = SWEEP_SETTLE;
+
+			if (++sw->step < THRUST_CAL_SWEEP_STEPS)
+			{
+				return true;
+			}
+
+			// Next motor (or the final save) after a rest with all motors off
+			memset(cmd, 0, THRUST_ALLOC_MOTORS);
+			sweep_phase = SWEEP_REST;
+			sw->motor++;
+			return true;
+		}
+	}
+}
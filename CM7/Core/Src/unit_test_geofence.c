@@ -0,0 +1,265 @@
+/**
+  ******************************************************************************
+  * @file           : unit_test_geofence.c
+  * @date           : Oct 19, 2026
+  * @brief          : Host-side test of geofence repulsion through motor_control.c
+  ******************************************************************************
+  * @attention
+  *
+  * Excluded from the firmware build. Build and run on the host from CM7/:
+  *   gcc -ICore/Inc -I../Drivers/STM32H7xx_HAL_Driver/Inc \
+  *       -I../Drivers/CMSIS/Device/ST/STM32H7xx/Include -I../Drivers/CMSIS/Include \
+  *       -I../Middlewares/Third_Party/FreeRTOS/Source/include \
+  *       -I../Middlewares/Third_Party/FreeRTOS/Source/portable/GCC/ARM_CM4F \
+  *       -IUSB_DEVICE/App -IUSB_DEVICE/Target \
+  *       -I../Middlewares/ST/STM32_USB_Device_Library/Core/Inc \
+  *       -I../Middlewares/ST/STM32_USB_Device_Library/Class/CDC/Inc \
+  *       -DCORE_CM7 -DUSE_HAL_DRIVER -DSTM32H755xx \
+  *       Core/Src/unit_test_geofence.c Core/Src/motor_control.c \
+  *       Core/Src/thrust_alloc.c Core/Src/pid.c -lm -o unit_test_geofence \
+  *     && ./unit_test_geofence
+  *
+  * The other modules motor_control.c calls are stubbed below. The fence is
+  * a keep-in boundary straight ahead of a boat heading north.
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "anchor_mpc.h"
+#include "contour.h"
+#include "drift.h"
+#include "geofence.h"
+#include "gps.h"
+#include "loiter.h"
+#include "motor_control.h"
+#include "obstacle.h"
+#include "radar.h"
+#include "thrust_alloc.h"
+#include "thrust_cal.h"
+#include "tim.h"
+#include "waypoint.h"
+
+#define TEST_SPEED_CMD   60U  // UI speed, 0-100
+
+/* Stubs ---------------------------------------------------------------------*/
+GPSDataStruct GPS_Data;
+RadarData radar_detections;
+DriftEstimate drift_estimate;
+ThrustCalTable thrust_cal_table;
+TIM_HandleTypeDef htim2;
+ContourStatus contour_status;
+
+static GeofenceResult test_fence;
+static bool test_fence_active;
+static ThrustWrench test_drift_wrench;
+static bool test_drift_wrench_known;
+
+void Geofence_Poll(void) {}
+
+bool Geofence_Query(double latitude, double longitude, GeofenceResult *result)
+{
+	(void)latitude;
+	(void)longitude;
+	*result = test_fence;
+	return test_fence_active;
+}
+
+void Drift_Update(const ThrustWrench *applied)
+{
+	test_drift_wrench_known = (applied != NULL);
+	if (applied != NULL)
+	{
+		test_drift_wrench = *applied;
+	}
+}
+
+void Drift_BodyWrench(float heading_deg, ThrustWrench *disturbance)
+{
+	(void)heading_deg;
+	memset(disturbance, 0, sizeof(*disturbance));
+}
+
+// Linear, so the test can read thrust back from the command
+uint8_t ThrustCal_ThrustToCmd(uint8_t motor, float thrust)
+{
+	(void)motor;
+	return (uint8_t)lroundf(thrust * 255.0f);
+}
+
+void ThrustCal_Start(void) {}
+bool ThrustCal_Step(float heading_deg, uint8_t cmd[THRUST_ALLOC_MOTORS])
+{
+	(void)heading_deg;
+	(void)cmd;
+	return false;
+}
+
+bool Obstacle_PlanVelocity(float preferred_north, float preferred_east,
+						   float *chosen_north, float *chosen_east)
+{
+	*chosen_north = preferred_north;
+	*chosen_east = preferred_east;
+	return false;
+}
+
+void Contour_Start(float heading_deg, direction_t shore_side, float target_depth_cm)
+{
+	(void)heading_deg;
+	(void)shore_side;
+	(void)target_depth_cm;
+}
+void Contour_AddSample(float depth_cm) { (void)depth_cm; }
+bool Contour_Steer(float *course_deg) { (void)course_deg; return false; }
+
+void AnchorMpc_Init(void) {}
+void AnchorMpc_Reset(const float velocity[ANCHOR_MPC_AXES]) { (void)velocity; }
+void AnchorMpc_Update(const float offset[ANCHOR_MPC_AXES], const ThrustWrench *drift,
+					  ThrustWrench *wrench)
+{
+	(void)offset;
+	(void)drift;
+	memset(wrench, 0, sizeof(*wrench));
+}
+
+float Loiter_MotorPowerW(float thrust) { return thrust; }
+void Loiter_Start(double latitude, double longitude, float radius_m)
+{
+	(void)latitude;
+	(void)longitude;
+	(void)radius_m;
+}
+void Loiter_Update(double latitude, double longitude, float power_w,
+				   float *thrust_north, float *thrust_east)
+{
+	(void)latitude;
+	(void)longitude;
+	(void)power_w;
+	*thrust_north = 0.0f;
+	*thrust_east = 0.0f;
+}
+
+void Waypoint_Start(double latitude, double longitude)
+{
+	(void)latitude;
+	(void)longitude;
+}
+bool Waypoint_Update(double latitude, double longitude, float cruise_mps,
+					 float *heading_sp_deg, float *speed_sp_mps)
+{
+	(void)latitude;
+	(void)longitude;
+	(void)cruise_mps;
+	(void)heading_sp_deg;
+	(void)speed_sp_mps;
+	return false;
+}
+
+void GPS_CalculateOffsetMeters(double desired_lat, double desired_lon,
+							   double current_lat, double current_lon,
+							   float *north_m, float *east_m)
+{
+	*north_m = (float)((desired_lat - current_lat) * 111320.0);
+	*east_m = (float)((desired_lon - current_lon) * 111320.0);
+}
+
+/* Test ----------------------------------------------------------------------*/
+static int failures = 0;
+
+static void check(int ok, const char *what)
+{
+	printf("  %s: %s\n", ok ? "PASS" : "FAIL", what);
+	if (!ok)
+	{
+		failures++;
+	}
+}
+
+// One control step of follow-shore at fence strength (0 for no fence).
+// Returns the wrench the motors produce.
+static ThrustWrench RunStep(float strength, motor_speed *cmd)
+{
+	MotorControlState state;
+	UIdata ui;
+	Sonar_t sonar;
+	float thrust[THRUST_ALLOC_MOTORS];
+	ThrustWrench out;
+
+	memset(&ui, 0, sizeof(ui));
+	memset(&sonar, 0, sizeof(sonar));
+	memset(cmd, 0, sizeof(*cmd));
+	ui.mode = MODE_FOLLOW_SHORE;
+	ui.direction_to_turn = RIGHT;
+	ui.speed = TEST_SPEED_CMD;
+
+	// Heading north, keep-in boundary ahead: the safe side is south
+	test_fence_active = (strength > 0.0f);
+	test_fence.violation = (strength >= 1.0f);
+	test_fence.margin_m = 0.0f;
+	test_fence.push_north = -1.0f;
+	test_fence.push_east = 0.0f;
+	test_fence.strength = strength;
+
+	MotorControl_InitState(&state);
+	MotorControl_UpdateDrift(MODE_FOLLOW_SHORE);
+	MotorControl_UpdateGeofence(MODE_FOLLOW_SHORE);
+	MotorControl_ModeFollowShore(&state, true, false, &ui, false, false, &sonar, cmd, NULL);
+	// Hands this step's applied wrench to the Drift_Update stub
+	MotorControl_UpdateDrift(MODE_FOLLOW_SHORE);
+
+	thrust[THRUST_ALLOC_MOTOR_45] = (float)cmd->speed_45 / 255.0f;
+	thrust[THRUST_ALLOC_MOTOR_135] = (float)cmd->speed_135 / 255.0f;
+	thrust[THRUST_ALLOC_MOTOR_225] = (float)cmd->speed_225 / 255.0f;
+	thrust[THRUST_ALLOC_MOTOR_315] = (float)cmd->speed_315 / 255.0f;
+	ThrustAlloc_Forward(thrust, &out);
+
+	printf("  motors 45 %u, 135 %u, 225 %u, 315 %u; surge %.3f, sway %.3f, yaw %.3f\n",
+		   cmd->speed_45, cmd->speed_135, cmd->speed_225, cmd->speed_315,
+		   out.surge, out.sway, out.yaw);
+	return out;
+}
+
+static int SameWrench(const ThrustWrench *a, const ThrustWrench *b)
+{
+	// One PWM step is 1/255 of thrust
+	const float tol = 0.01f;
+
+	return (fabsf(a->surge - b->surge) < tol) && (fabsf(a->sway - b->sway) < tol)
+		&& (fabsf(a->yaw - b->yaw) < tol);
+}
+
+int main(void)
+{
+	motor_speed cmd;
+	ThrustWrench free_run;
+	ThrustWrench near;
+	ThrustWrench over;
+
+	memset(&GPS_Data, 0, sizeof(GPS_Data));
+	memset(&radar_detections, 0, sizeof(radar_detections));
+
+	printf("Follow shore, no fence\n");
+	free_run = RunStep(0.0f, &cmd);
+	check(free_run.surge > 0.0f, "drives forward");
+	check(cmd.speed_45 == 0U && cmd.speed_315 == 0U, "forward only: 45 and 315 off");
+	check(test_drift_wrench_known && SameWrench(&test_drift_wrench, &free_run),
+		  "drift estimator sees the wrench applied");
+
+	printf("Follow shore, keep-in boundary ahead within the margin\n");
+	near = RunStep(0.25f, &cmd);
+	check(near.surge > 0.0f && near.surge < free_run.surge, "slows down");
+	check(test_drift_wrench_known && SameWrench(&test_drift_wrench, &near),
+		  "drift estimator sees the wrench applied");
+
+	printf("Follow shore, at the keep-in boundary\n");
+	over = RunStep(1.0f, &cmd);
+	check(over.surge < 0.0f, "reverses away from the boundary");
+	check(cmd.speed_45 > 0U && cmd.speed_315 > 0U, "uses the reverse pair");
+	check(test_drift_wrench_known && SameWrench(&test_drift_wrench, &over),
+		  "drift estimator sees the wrench applied");
+
+	printf("%s (%d failures)\n", failures == 0 ? "ALL PASS" : "FAILED", failures);
+	return failures == 0 ? 0 : 1;
+}
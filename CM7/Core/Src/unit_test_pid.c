@@ -0,0 +1,154 @@
+/**
+  ******************************************************************************
+  * @file           : unit_test_pid.c
+  * @date           : Oct 19, 2026
+  * @brief          : Host-side step response test for pid.c
+  ******************************************************************************
+  * @attention
+  *
+  * Excluded from the firmware build. Build and run on the host:
+  *   gcc -I../Inc unit_test_pid.c pid.c -lm -o unit_test_pid && ./unit_test_pid
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include <math.h>
+#include <stdio.h>
+
+#include "pid.h"
+
+#define TEST_DT_S        0.01f
+#define TEST_DURATION_S  60.0f
+#define TEST_KP          0.2f
+#define TEST_KI          0.01f
+#define TEST_KD          0.3f
+#define TEST_LIMIT       0.5f
+
+// Boat on one axis: thrust u (0-1 of a thruster pair) against linear drag.
+//   x'' = (gain * u - drag * x' + disturbance) / mass
+typedef struct
+{
+	float mass;
+	float drag;
+	float gain;
+	float disturbance;
+	float x;
+	float v;
+} Plant;
+
+typedef struct
+{
+	float overshoot;
+	float settle_s;
+	float final_error;
+	float u_min;
+	float u_max;
+	float saturated_s;
+} StepResult;
+
+static int failures = 0;
+
+static void check(int ok, const char *what)
+{
+	printf("  %s: %s\n", ok ? "PASS" : "FAIL", what);
+	if (!ok)
+	{
+		failures++;
+	}
+}
+
+static void Plant_Step(Plant *p, float u, float dt)
+{
+	float a = ((p->gain * u) - (p->drag * p->v) + p->disturbance) / p->mass;
+	p->v += a * dt;
+	p->x += p->v * dt;
+}
+
+static StepResult RunStep(PID_t *pid, Plant *plant, float setpoint, float sample_period_s,
+						  float duration_s)
+{
+	StepResult r = {0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+	float measured = plant->x;
+	float next_sample_s = 0.0f;
+	float band = 0.05f * fabsf(setpoint - plant->x);
+	float start = plant->x;
+
+	PID_Reset(pid);
+
+	for (float t = 0.0f; t < duration_s; t += TEST_DT_S)
+	{
+		// Position is only measured at the GNSS rate.
+		if (t >= next_sample_s)
+		{
+			measured = plant->x;
+			next_sample_s += sample_period_s;
+		}
+
+		float u = PID_Update(pid, setpoint - measured);
+		Plant_Step(plant, u, TEST_DT_S);
+
+		if (u < r.u_min) { r.u_min = u; }
+		if (u > r.u_max) { r.u_max = u; }
+		if (fabsf(u) >= (TEST_LIMIT - 1e-6f)) { r.saturated_s += TEST_DT_S; }
+
+		float over = (plant->x - setpoint) / (setpoint - start);
+		if (over > r.overshoot) { r.overshoot = over; }
+
+		if (fabsf(plant->x - setpoint) > band)
+		{
+			r.settle_s = -1.0f;
+		}
+		else if (r.settle_s < 0.0f)
+		{
+			r.settle_s = t;
+		}
+	}
+
+	r.final_error = setpoint - plant->x;
+	return r;
+}
+
+int main(void)
+{
+	PID_t pid;
+	Plant plant;
+	StepResult r;
+
+	printf("Step 5 m, no disturbance\n");
+	PID_Init(&pid, TEST_KP, TEST_KI, TEST_KD, TEST_DT_S, 0.3f, -TEST_LIMIT, TEST_LIMIT);
+	plant = (Plant){ 120.0f, 40.0f, 60.0f, 0.0f, 0.0f, 0.0f };
+	r = RunStep(&pid, &plant, 5.0f, 0.1f, TEST_DURATION_S);
+	printf("  overshoot %.1f %%, settle %.1f s, error %.3f m, u [%.2f, %.2f]\n",
+		   100.0f * r.overshoot, r.settle_s, r.final_error, r.u_min, r.u_max);
+	check(r.u_min >= -TEST_LIMIT && r.u_max <= TEST_LIMIT, "output within limits");
+	check(r.overshoot < 0.2f, "overshoot below 20 %");
+	check(r.settle_s > 0.0f && r.settle_s < 30.0f, "settles within 30 s");
+
+	printf("Step 5 m against a steady current\n");
+	plant = (Plant){ 120.0f, 40.0f, 60.0f, -10.0f, 0.0f, 0.0f };
+	r = RunStep(&pid, &plant, 5.0f, 0.1f, TEST_DURATION_S);
+	printf("  overshoot %.1f %%, settle %.1f s, error %.3f m, u [%.2f, %.2f]\n",
+		   100.0f * r.overshoot, r.settle_s, r.final_error, r.u_min, r.u_max);
+	check(fabsf(r.final_error) < 0.1f, "integrator removes steady error");
+
+	// Full thrust moves the plant at 0.75 m/s, so 20 m keeps the output
+	// saturated for most of the way and the response must still settle.
+	printf("Step 20 m, output saturated for a long time\n");
+	plant = (Plant){ 120.0f, 40.0f, 60.0f, 0.0f, 0.0f, 0.0f };
+	r = RunStep(&pid, &plant, 20.0f, 0.1f, 2.0f * TEST_DURATION_S);
+	printf("  overshoot %.1f %%, settle %.1f s, error %.3f m, saturated %.1f s\n",
+		   100.0f * r.overshoot, r.settle_s, r.final_error, r.saturated_s);
+	check(r.saturated_s > 15.0f, "output saturated long enough to wind up");
+	check(r.overshoot < 0.1f, "no wind-up overshoot");
+	check(r.settle_s > 0.0f && r.settle_s < 40.0f, "settles within 40 s");
+
+	printf("Reset does not kick the derivative\n");
+	PID_Reset(&pid);
+	// Small enough not to saturate
+	float u0 = PID_Update(&pid, 1.0f);
+	check(fabsf(u0 - ((TEST_KP * 1.0f) + (TEST_KI * 1.0f * TEST_DT_S))) < 1e-6f,
+		  "first output is P + I only");
+
+	printf("%s (%d failures)\n", failures == 0 ? "ALL PASS" : "FAILED", failures);
+	return failures == 0 ? 0 : 1;
+}
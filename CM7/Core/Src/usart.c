@@ -24,7 +24,10 @@
 #include "task.h"
 #include "cmsis_os.h"
 extern osThreadId_t GPSTaskHandle;
+#include "geofence.h"
 #include "radar.h"
+#include "waypoint.h"
+#include <string.h>
 /* USER CODE END 0 */
 
 UART_HandleTypeDef huart4;
@@ -413,6 +416,23 @@ void HAL_UART_MspDeInit(UART_HandleTypeDef* uartHandle)
 
 /* USER CODE BEGIN 1 */
 
+// USART6 TX is shared by the GPS and radar tasks. Take the line before
+// starting a transfer; HAL_UART_TxCpltCallback gives it back.
+bool USART6_ClaimTx(void)
+{
+  bool claimed = false;
+
+  taskENTER_CRITICAL();
+  if (usart6_tx_complete)
+  {
+    usart6_tx_complete = false;
+    claimed = true;
+  }
+  taskEXIT_CRITICAL();
+
+  return claimed;
+}
+
 // Used for Sonar and UI
 void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
 {
@@ -436,6 +456,24 @@ void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
 			  radar_task_update = radar_detections.radar_state;
 		  }
 	}
+	else if (ui_state.rx_data[0] == 0x68)
+	{
+		// Radar parameter get / set, forwarded to the Pi by the radar task
+		radar_param_request.op = ui_state.rx_data[1];
+		radar_param_request.id = ui_state.rx_data[2];
+		memcpy(&radar_param_request.value, &ui_state.rx_data[3], 4);
+		radar_param_request.pending = true;
+	}
+	else if (ui_state.rx_data[0] == WAYPOINT_ESP32_START)
+	{
+		// Route upload, one field of one waypoint per frame
+		Waypoint_RxFrame(ui_state.rx_data);
+	}
+	else if (ui_state.rx_data[0] == GEOFENCE_ESP32_START)
+	{
+		// Geofence upload, one field per frame
+		Geofence_RxFrame(ui_state.rx_data);
+	}
 	else if (ui_state.rx_data[0] == 0x69)
 	{
 		// State information
@@ -489,7 +527,7 @@ void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
   if (huart->Instance == USART6)
   {
     HAL_UART_Abort(&huart6);  // Forces RxState back to Ready
-    HAL_UART_Receive_IT(&huart6, ui_state.rx_data, 7);
+    HAL_UART_Receive_IT(&huart6, ui_state.rx_data, 8);
   }
 }
 /* USER CODE END 1 */
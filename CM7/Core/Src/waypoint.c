@@ -0,0 +1,251 @@
+/*
+ * waypoint.c
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include "waypoint.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "gps.h"
+#include "usart.h"
+
+#define WAYPOINT_ARRIVAL_RADIUS_M    3.0f
+// Line-of-sight lookahead along the track. Shorter converges on the track
+// faster but weaves more.
+#define WAYPOINT_LOOKAHEAD_M         8.0f
+// Slow down approaching the final waypoint: speed = gain * distance
+#define WAYPOINT_APPROACH_GAIN_PER_S 0.1f
+#define WAYPOINT_MIN_SPEED_MPS       0.3f
+
+#define WAYPOINT_RAD_TO_DEG          57.2957795f
+
+// Route being uploaded, filled from the USART6 interrupt
+typedef struct
+{
+	int32_t lat_e7[WAYPOINT_MAX];
+	int32_t lon_e7[WAYPOINT_MAX];
+	uint32_t lat_mask;
+	uint32_t lon_mask;
+	uint8_t count;
+	bool ready;
+} WaypointUpload;
+
+WaypointRoute waypoint_route;
+WaypointStatus waypoint_status;
+
+static WaypointUpload waypoint_upload;
+static double leg_start_lat;
+static double leg_start_lon;
+static uint8_t waypoint_tx_buffer[32] __attribute__((aligned(32)));
+
+void Waypoint_RxFrame(const uint8_t frame[8])
+{
+	uint8_t op = frame[1];
+	uint8_t arg = frame[2];
+	int32_t value;
+
+	memcpy(&value, &frame[3], 4);
+
+	if (op == WAYPOINT_OP_BEGIN)
+	{
+		waypoint_upload.lat_mask = 0U;
+		waypoint_upload.lon_mask = 0U;
+		waypoint_upload.count = (arg <= WAYPOINT_MAX) ? arg : 0U;
+		waypoint_upload.ready = false;
+	}
+	else if ((op == WAYPOINT_OP_LAT) && (arg < waypoint_upload.count))
+	{
+		waypoint_upload.lat_e7[arg] = value;
+		waypoint_upload.lat_mask |= (1UL << arg);
+	}
+	else if ((op == WAYPOINT_OP_LON) && (arg < waypoint_upload.count))
+	{
+		waypoint_upload.lon_e7[arg] = value;
+		waypoint_upload.lon_mask |= (1UL << arg);
+	}
+	else if (op == WAYPOINT_OP_COMMIT)
+	{
+		uint32_t full = (waypoint_upload.count >= 32U) ? 0xFFFFFFFFUL : ((1UL << waypoint_upload.count) - 1UL);
+
+		// Every point must have arrived, or a lost frame would send the
+		// boat to 0, 0.
+		if ((arg == waypoint_upload.count) && (arg > 0U)
+			&& (waypoint_upload.lat_mask == full) && (waypoint_upload.lon_mask == full))
+		{
+			waypoint_upload.ready = true;
+			waypoint_status.upload_rejected = false;
+		}
+		else
+		{
+			// Navigation carries on with the route it has
+			waypoint_status.upload_rejected = true;
+		}
+	}
+}
+
+void Waypoint_Start(double latitude, double longitude)
+{
+	bool new_route = false;
+
+	taskENTER_CRITICAL();
+	if (waypoint_upload.ready)
+	{
+		for (uint8_t i = 0U; i < waypoint_upload.count; i++)
+		{
+			waypoint_route.latitude[i] = (double)waypoint_upload.lat_e7[i] * 1e-7;
+			waypoint_route.longitude[i] = (double)waypoint_upload.lon_e7[i] * 1e-7;
+		}
+		waypoint_route.count = waypoint_upload.count;
+		waypoint_upload.ready = false;
+		new_route = true;
+	}
+	taskEXIT_CRITICAL();
+
+	if (waypoint_route.count == 0U)
+	{
+		waypoint_status.state = WAYPOINT_NO_ROUTE;
+		return;
+	}
+
+	// Keep going on a route in progress (e.g. a speed change from the UI)
+	if (!new_route && (waypoint_status.state == WAYPOINT_ACTIVE))
+	{
+		return;
+	}
+
+	waypoint_status.active_index = 0U;
+	waypoint_status.state = WAYPOINT_ACTIVE;
+	leg_start_lat = latitude;
+	leg_start_lon = longitude;
+}
+
+bool Waypoint_Update(double latitude, double longitude, float cruise_mps,
+					 float *heading_sp_deg, float *speed_sp_mps)
+{
+	if (waypoint_status.state != WAYPOINT_ACTIVE)
+	{
+		return false;
+	}
+
+	for (;;)
+	{
+		uint8_t i = waypoint_status.active_index;
+		float leg_n = 0.0f;
+		float leg_e = 0.0f;
+		float pos_n = 0.0f;
+		float pos_e = 0.0f;
+
+		// Local frame with its origin at the start of the leg
+		GPS_CalculateOffsetMeters(leg_start_lat, leg_start_lon,
+								  waypoint_route.latitude[i], waypoint_route.longitude[i],
+								  &leg_n, &leg_e);
+		GPS_CalculateOffsetMeters(leg_start_lat, leg_start_lon, latitude, longitude, &pos_n, &pos_e);
+
+		float leg_len = sqrtf((leg_n * leg_n) + (leg_e * leg_e));
+		float to_n = leg_n - pos_n;
+		float to_e = leg_e - pos_e;
+		float distance = sqrtf((to_n * to_n) + (to_e * to_e));
+
+		float along = 0.0f;
+		float cross = 0.0f;
+		if (leg_len > 0.01f)
+		{
+			float t_n = leg_n / leg_len;
+			float t_e = leg_e / leg_len;
+			along = (pos_n * t_n) + (pos_e * t_e);
+			cross = (pos_e * t_n) - (pos_n * t_e);
+		}
+
+		// Arrived, or passed abeam of the waypoint: on to the next leg
+		if ((distance < WAYPOINT_ARRIVAL_RADIUS_M) || (along > leg_len))
+		{
+			leg_start_lat = waypoint_route.latitude[i];
+			leg_start_lon = waypoint_route.longitude[i];
+
+			if ((i + 1U) >= waypoint_route.count)
+			{
+				waypoint_status.state = WAYPOINT_ARRIVED;
+				waypoint_status.distance_m = distance;
+				waypoint_status.cross_track_m = 0.0f;
+				waypoint_status.speed_sp_mps = 0.0f;
+				return false;
+			}
+
+			waypoint_status.active_index = i + 1U;
+			continue;
+		}
+
+		// Line of sight: track direction, turned towards the track by the
+		// cross-track error over the lookahead distance.
+		float track_deg = atan2f(leg_e, leg_n) * WAYPOINT_RAD_TO_DEG;
+		if (leg_len <= 0.01f)
+		{
+			track_deg = atan2f(to_e, to_n) * WAYPOINT_RAD_TO_DEG;
+		}
+		float heading = track_deg - (atanf(cross / WAYPOINT_LOOKAHEAD_M) * WAYPOINT_RAD_TO_DEG);
+		if (heading < 0.0f)
+		{
+			heading += 360.0f;
+		}
+		else if (heading >= 360.0f)
+		{
+			heading -= 360.0f;
+		}
+
+		float speed = cruise_mps;
+		if ((i + 1U) >= waypoint_route.count)
+		{
+			float approach = WAYPOINT_APPROACH_GAIN_PER_S * distance;
+			if (approach < WAYPOINT_MIN_SPEED_MPS)
+			{
+				approach = WAYPOINT_MIN_SPEED_MPS;
+			}
+			if (approach < speed)
+			{
+				speed = approach;
+			}
+		}
+
+		waypoint_status.distance_m = distance;
+		waypoint_status.cross_track_m = cross;
+		waypoint_status.heading_sp_deg = heading;
+		waypoint_status.speed_sp_mps = speed;
+
+		*heading_sp_deg = heading;
+		*speed_sp_mps = speed;
+		return true;
+	}
+}
+
+void Waypoint_TxTelemetry(void)
+{
+	if (((waypoint_status.state == WAYPOINT_NO_ROUTE) && !waypoint_status.upload_rejected) || !USART6_ClaimTx())
+	{
+		return;
+	}
+
+	float dist_dm = waypoint_status.distance_m * 10.0f;
+	float cross_dm = waypoint_status.cross_track_m * 10.0f;
+	uint16_t dist = (dist_dm > 65535.0f) ? 65535U : (uint16_t)dist_dm;
+	int16_t cross = (cross_dm > 32767.0f) ? 32767 : ((cross_dm < -32767.0f) ? -32767 : (int16_t)cross_dm);
+	uint8_t *p = waypoint_tx_buffer;
+
+	*p++ = WAYPOINT_TELEMETRY_START;
+	*p++ = waypoint_status.active_index;
+	*p++ = waypoint_route.count;
+	*p++ = (uint8_t)waypoint_status.state | (waypoint_status.upload_rejected ? WAYPOINT_TELEMETRY_REJECTED : 0U);
+	memcpy(p, &dist, 2); p += 2;
+	memcpy(p, &cross, 2);
+
+	SCB_CleanDCache_by_Addr((uint32_t *)waypoint_tx_buffer, sizeof(waypoint_tx_buffer));
+
+	if (HAL_UART_Transmit_DMA(&huart6, waypoint_tx_buffer, WAYPOINT_TELEMETRY_TX_LEN) != HAL_OK)
+	{
+		usart6_tx_complete = true;
+	}
+}
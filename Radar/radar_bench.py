@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+"""
+radar_bench.py
+
+Offline timing of the radar processing on recorded IQ.
+
+Input is a .npz block or a directory of them, as written by
+    python3 radar_usb.py --capture DIR
+Each block holds one accumulated receive block per channel:
+    r0 - RX0 complex samples
+    r1 - RX1 complex samples
+
+Every block is pushed through process_block() (the same code the radar runs)
+and make_ascii_packet(), and per-stage times are reported:
+    sync, dechirp, spectrum, detection, packet
+
+The first block is also run through the full-rate (legacy) and decimated
+beat spectra, printing ms per frame and the detected beat frequency for each,
+so a change to BEAT_DECIM / BEAT_CIC_ORDER can be checked before it goes on
+the kayak.
+
+Usage:
+    python3 radar_bench.py PATH [repeats]
+"""
+
+import sys
+import time
+import numpy as np
+
+import radar_usb as ru
+
+
+def time_spectrum(name, decim, beat0, beat1, repeats):
+    ru.BEAT_DECIM = decim
+    ru.clear_beat_plans()
+
+    # First call builds the plan; keep it out of the timing.
+    det = ru.detect_target_bin_with_bg(
+        beat0, beat1, ru.FS, ru.FB_MIN_HZ, ru.FB_MAX_HZ, None, None
+    )
+
+    t0 = time.perf_counter()
+    for _ in range(repeats):
+        det = ru.detect_target_bin_with_bg(
+            beat0, beat1, ru.FS, ru.FB_MIN_HZ, ru.FB_MAX_HZ, None, None
+        )
+    dt_ms = (time.perf_counter() - t0) * 1000.0 / repeats
+
+    print(f"{name:8s} decim={decim:3d}  {dt_ms:8.3f} ms/frame  "
+          f"fb={det['fb_hz']:8.1f} Hz  bins={det['freqs'].size}")
+
+    return det
+
+
+def compare_spectra(r0, r1, pre, chirp, frame, repeats):
+    start = ru.track_frame_start(r0, pre, len(frame), ru.new_sync_state())
+
+    if start is None:
+        print("No frame sync in first block")
+        return
+
+    beats = ru.dechirp_block(r0, r1, start, pre, chirp, frame)
+
+    if beats is None:
+        print("No full frame in first block")
+        return
+
+    beat0 = beats[0].reshape(-1)
+    beat1 = beats[1].reshape(-1)
+
+    print(f"First block: {r0.size} samples, frame start {start}, {beats[0].shape[0]} chirps")
+
+    decim = ru.BEAT_DECIM
+
+    ref = time_spectrum("legacy", 1, beat0, beat1, repeats)
+    new = time_spectrum("decim", max(decim, 2), beat0, beat1, repeats)
+
+    bin_hz = ref["freqs"][1] - ref["freqs"][0] if ref["freqs"].size > 1 else 0.0
+    print(f"fb difference {abs(new['fb_hz'] - ref['fb_hz']):.1f} Hz "
+          f"(legacy bin spacing {bin_hz:.1f} Hz)")
+
+    ru.BEAT_DECIM = decim
+    ru.clear_beat_plans()
+
+
+def time_pipeline(replay, pre, chirp, frame, repeats):
+    bg_state = ru.new_background_state(load=False, persist=False)
+
+    sync_state = ru.new_sync_state()
+    stats = ru.new_pipeline_stats()
+
+    blocks = 0
+    totals = []
+
+    while True:
+        try:
+            r0, r1 = ru.acquire_accumulated_rx(replay)
+        except EOFError:
+            break
+
+        for _ in range(repeats):
+            t0 = time.perf_counter()
+
+            targets = ru.process_block(r0, r1, pre, chirp, frame, bg_state, sync_state, stats)
+
+            t1 = time.perf_counter()
+            ru.make_ascii_packet(targets)
+            ru.add_stage_time(stats, "packet", t1)
+
+            totals.append(time.perf_counter() - t0)
+            blocks += 1
+
+    if blocks == 0:
+        print("No blocks processed")
+        return
+
+    totals_ms = 1000.0 * np.array(totals)
+
+    print(f"{blocks} blocks processed ({sync_state['tracked']} tracked, "
+          f"{sync_state['reacquired']} full sync acquisitions)")
+    print(ru.format_stage_times(stats, blocks))
+    print(f"Total ms/block: avg {totals_ms.mean():.2f}, "
+          f"p95 {np.percentile(totals_ms, 95):.2f}, max {totals_ms.max():.2f}")
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__)
+        return 1
+
+    repeats = int(sys.argv[2]) if len(sys.argv) > 2 else 1
+
+    replay = ru.open_replay(sys.argv[1])
+
+    pre, chirp, frame, _ = ru.build_tx_frame()
+
+    r0, r1 = ru.replay_next_block(replay)
+    compare_spectra(r0, r1, pre, chirp, frame, max(repeats, 20))
+
+    replay["index"] = 0
+    time_pipeline(replay, pre, chirp, frame, repeats)
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
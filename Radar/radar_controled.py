@@ -5,12 +5,24 @@ radar_controlled.py
 Runs on Raspberry Pi.
 
 Purpose:
+- Single radar daemon. The Pluto is configured, the TX frame built and the
+  STM32 serial port opened once at startup.
 - Waits for commands from the STM32 over USB serial.
-- STM32 sends:
+- STM32 sends (repeatedly, every radar task period):
       0x671\n  -> turn radar on
       0x670\n  -> turn radar off
-- When radar is turned on, this script starts radar_usb.py.
-- When radar is turned off, this script stops radar_usb.py.
+- RX streams all the time; on and off only gate the Pluto TX buffer and the
+  packet output. The first packet after on is the first block acquired after
+  TX came up, so it takes one block read plus processing (logged as
+  "First radar packet ... ms after on") instead of restarting radar_usb.py.
+- Radar packets are written to the same serial port.
+- Parameter get / set lines from the ESP32 UI (see RADAR_PARAMS in
+  radar_usb.py) are relayed by the STM32:
+      #S,id,value\n  -> set
+      #G,id\n        -> get
+  They are applied by the processing thread between blocks, so gains,
+  search band and thresholds change live, and each is answered with
+      #V,id,value,status\n
 
 This file is meant to be started automatically by radar.service.
 """
@@ -19,9 +31,13 @@ import os
 import sys
 import time
 import glob
-import signal
+import queue
 import serial
-import subprocess
+import threading
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+
+import radar_usb as ru
 
 
 # -------------------------------------------------
@@ -30,23 +46,13 @@ import subprocess
 
 USB_BAUD = 9600
 
-# This should be the folder where both radar_controlled.py
-# and radar_usb.py are located.
-RADAR_DIR = "/home/analog/radar"
-
-# Full path to radar_usb.py
-RADAR_USB_FILE = os.path.join(RADAR_DIR, "radar_usb.py")
-
-# Use the same Python interpreter that is running this script.
-# This is important if radar.service uses the virtual environment.
-PYTHON_EXE = sys.executable
-
 # STM32 command values
 RADAR_ON_CMD = "0x671"
 RADAR_OFF_CMD = "0x670"
 
-# Time between checking the serial port
-LOOP_DELAY_S = 0.05
+# Longest wait for a block before queued parameter commands are applied.
+# While the radar is off no blocks arrive, so this is the reply delay.
+PARAM_POLL_S = 0.1
 
 
 # -------------------------------------------------
@@ -105,6 +111,7 @@ def open_stm_serial():
     )
 
     # Some STM32 boards reset when the serial port opens.
+    # Only paid once, when the daemon starts.
     time.sleep(2.0)
 
     print("STM32 serial ready", flush=True)
@@ -113,99 +120,181 @@ def open_stm_serial():
 
 
 # -------------------------------------------------
-# Radar subprocess control
+# Radar on / off
 # -------------------------------------------------
 
-def radar_is_running(proc):
+def new_radar(sdr, ser):
     """
-    Returns True if radar_usb.py subprocess is still running.
+    Radar daemon state shared by the command loop and the processing thread.
     """
-
-    if proc is None:
-        return False
-
-    return proc.poll() is None
-
-
-def start_radar(proc):
+    pre, chirp, frame, tx_wave = ru.build_tx_frame()
+
+    return {
+        "sdr": sdr,
+        "ser": ser,
+        "ser_lock": threading.Lock(),
+        "pre": pre,
+        "chirp": chirp,
+        "frame": frame,
+        "tx_wave": tx_wave,
+        "run_event": threading.Event(),
+        "stop_event": threading.Event(),
+        "t_on": 0.0,
+        "t_tx_ready": 0.0,
+        "first_packet_pending": False,
+        "bg_state": ru.new_background_state(),
+        "sync_state": ru.new_sync_state(),
+        "stats": ru.new_pipeline_stats(),
+        "param_queue": queue.Queue(),
+    }
+
+
+def radar_on(radar):
     """
-    Starts radar_usb.py if it is not already running.
+    Starts TX and opens the packet gate. Repeated commands are ignored.
     """
+    if radar["run_event"].is_set():
+        return
 
-    if radar_is_running(proc):
-        print("Radar is already running", flush=True)
-        return proc
-
-    if not os.path.exists(RADAR_USB_FILE):
-        print(f"ERROR: radar_usb.py not found at {RADAR_USB_FILE}", flush=True)
-        return None
-
-    print("Starting radar_usb.py", flush=True)
-    print(f"Command: {PYTHON_EXE} {RADAR_USB_FILE}", flush=True)
+    t0 = time.monotonic()
 
-    proc = subprocess.Popen(
-        [PYTHON_EXE, RADAR_USB_FILE],
-        cwd=RADAR_DIR,
-        stdout=subprocess.PIPE,
-        stderr=subprocess.STDOUT,
-        text=True,
-        bufsize=1,
-    )
+    ru.start_tx(radar["sdr"], radar["tx_wave"], settle_s=0.0)
 
-    print(f"radar_usb.py started with PID {proc.pid}", flush=True)
+    radar["t_on"] = t0
+    radar["t_tx_ready"] = time.monotonic() + ru.TX_ON_SETTLE_S
+    radar["first_packet_pending"] = True
+    radar["run_event"].set()
 
-    return proc
+    print(f"Radar on in {1000.0 * (time.monotonic() - t0):.1f} ms", flush=True)
 
 
-def stop_radar(proc):
+def radar_off(radar):
     """
-    Stops radar_usb.py if it is running.
+    Closes the packet gate and stops TX. Repeated commands are ignored.
     """
+    if not radar["run_event"].is_set():
+        return
 
-    if not radar_is_running(proc):
-        print("Radar is already stopped", flush=True)
-        return None
+    t0 = time.monotonic()
 
-    print("Stopping radar_usb.py", flush=True)
+    radar["run_event"].clear()
+    ru.stop_tx(radar["sdr"])
 
-    try:
-        proc.terminate()
+    print(f"Radar off in {1000.0 * (time.monotonic() - t0):.1f} ms", flush=True)
 
-        try:
-            proc.wait(timeout=5)
-            print("radar_usb.py stopped cleanly", flush=True)
 
-        except subprocess.TimeoutExpired:
-            print("radar_usb.py did not stop cleanly. Killing it.", flush=True)
-            proc.kill()
-            proc.wait(timeout=5)
-            print("radar_usb.py killed", flush=True)
+def apply_param_commands(radar):
+    """
+    Runs queued parameter commands and answers each one. Called from the
+    processing thread only, so settings never change in the middle of a block.
+    """
+    while True:
+        try:
+            cmd = radar["param_queue"].get_nowait()
+        except queue.Empty:
+            return
 
-    except Exception as e:
-        print("Error while stopping radar_usb.py:", repr(e), flush=True)
+        msg = ru.handle_param_command(cmd, radar["sdr"], radar["bg_state"])
 
-    return None
+        with radar["ser_lock"]:
+            ru.send_packet(radar["ser"], msg)
 
 
-def read_radar_output(proc):
+def processing_worker(radar, block_queue):
     """
-    Reads and prints any available output from radar_usb.py.
-
-    This keeps the systemd journal useful because output from radar_usb.py
-    will show up under radar.service.
+    Processes acquired blocks and sends packets while the radar is on.
     """
+    last_send = 0.0
+    last_profile = 0.0
+    profile_seq = 0
 
-    if not radar_is_running(proc):
-        return
+    while not radar["stop_event"].is_set():
+        apply_param_commands(radar)
 
-    if proc.stdout is None:
-        return
+        try:
+            block = block_queue.get(timeout=PARAM_POLL_S)
+        except queue.Empty:
+            continue
+
+        # Drop anything acquired while off or before TX was on the air.
+        if not radar["run_event"].is_set() or block["t_acq"] < radar["t_tx_ready"]:
+            continue
+
+        stats = radar["stats"]
 
-    # Non-blocking stdout reading is tricky with pipes.
-    # This function is intentionally simple.
-    # The radar program output may still appear through systemd depending
-    # on how the service is configured.
-    return
+        if ru.RANGE_PROFILE_ENABLED and time.monotonic() - last_profile >= ru.RANGE_PROFILE_PERIOD_S:
+            outputs = {}
+        else:
+            outputs = None
+
+        try:
+            targets = ru.process_block(
+                block["r0"],
+                block["r1"],
+                radar["pre"],
+                radar["chirp"],
+                radar["frame"],
+                radar["bg_state"],
+                radar["sync_state"],
+                stats,
+                outputs
+            )
+        except Exception as e:
+            print("Radar processing error:", repr(e), flush=True)
+            targets = []
+
+        t0 = time.perf_counter()
+        msg = ru.make_ascii_packet(targets)
+        ru.add_stage_time(stats, "packet", t0)
+
+        # Radar may have been switched off while this block was processed.
+        if not radar["run_event"].is_set():
+            continue
+
+        now = time.monotonic()
+
+        if now - last_send >= ru.MIN_SEND_PERIOD_S:
+            with radar["ser_lock"]:
+                sent = ru.send_packet(radar["ser"], msg)
+
+            if sent:
+                stats["packets"] += 1
+
+                if radar["first_packet_pending"]:
+                    radar["first_packet_pending"] = False
+                    print(
+                        f"First radar packet {1000.0 * (now - radar['t_on']):.0f} ms after on",
+                        flush=True
+                    )
+
+            last_send = now
+
+        if outputs is not None and "profile" in outputs:
+            msg = ru.make_profile_packet(outputs["profile"], profile_seq)
+            profile_seq += 1
+            last_profile = now
+
+            with radar["ser_lock"]:
+                ru.send_packet(radar["ser"], msg)
+
+        latency = time.monotonic() - block["t_acq"]
+        stats["blocks"] += 1
+        stats["latency_sum"] += latency
+        stats["latency_max"] = max(stats["latency_max"], latency)
+
+        ru.report_pipeline_stats(stats, radar["sync_state"])
+
+
+def start_processing(radar, block_queue):
+    thread = threading.Thread(
+        target=processing_worker,
+        args=(radar, block_queue),
+        name="radar_proc",
+        daemon=True,
+    )
+    thread.start()
+
+    return thread
 
 
 # -------------------------------------------------
@@ -244,6 +333,25 @@ def parse_command(line):
     return cmd
 
 
+def handle_command(radar, cmd):
+    if cmd.startswith("#"):
+        param_cmd = ru.parse_param_command(cmd.upper())
+
+        if param_cmd is None:
+            print(f"Bad parameter command from STM32: {cmd}", flush=True)
+        else:
+            radar["param_queue"].put(param_cmd)
+
+    elif cmd == RADAR_ON_CMD:
+        radar_on(radar)
+
+    elif cmd == RADAR_OFF_CMD:
+        radar_off(radar)
+
+    elif cmd != "":
+        print(f"Unknown command from STM32: {cmd}", flush=True)
+
+
 # -------------------------------------------------
 # Main
 # -------------------------------------------------
@@ -254,26 +362,35 @@ def main():
     print("STM32 sends:", flush=True)
     print("  0x671 -> turn radar on", flush=True)
     print("  0x670 -> turn radar off", flush=True)
-    print(f"Radar script path: {RADAR_USB_FILE}", flush=True)
-    print(f"Python interpreter: {PYTHON_EXE}", flush=True)
 
+    sdr = None
     ser = None
-    radar_proc = None
+    radar = None
+    acq_thread = None
+    proc_thread = None
 
     try:
+        sdr = ru.setup_pluto()
+
+        # Radar starts off: nothing is transmitted until the STM32 asks.
+        ru.stop_tx(sdr)
+
         ser = open_stm_serial()
 
+        radar = new_radar(sdr, ser)
+
+        # RX keeps streaming while the radar is off, so no stale-sample
+        # discards are needed and radar-on waits for one read only.
+        block_queue, acq_stop, acq_thread = ru.start_acquisition(
+            sdr, radar["stats"], discard_reads=0
+        )
+        radar["stop_event"] = acq_stop
+
+        proc_thread = start_processing(radar, block_queue)
+
         print("Ready. Waiting for STM32 0x671 command.", flush=True)
 
         while True:
-            # If radar_usb.py crashed, clear the process handle.
-            if radar_proc is not None and radar_proc.poll() is not None:
-                print(
-                    f"radar_usb.py exited with code {radar_proc.returncode}",
-                    flush=True
-                )
-                radar_proc = None
-
             try:
                 raw = ser.readline()
 
@@ -283,34 +400,25 @@ def main():
                     except Exception:
                         line = ""
 
-                    cmd = parse_command(line)
-
-                    if cmd != "":
-                        print(f"Received STM32 command: {cmd}", flush=True)
-
-                    if cmd == RADAR_ON_CMD:
-                        radar_proc = start_radar(radar_proc)
-
-                    elif cmd == RADAR_OFF_CMD:
-                        radar_proc = stop_radar(radar_proc)
-
-                    elif cmd != "":
-                        print(f"Unknown command from STM32: {cmd}", flush=True)
+                    handle_command(radar, parse_command(line))
 
             except serial.SerialException as e:
                 print("Serial error:", repr(e), flush=True)
                 print("Trying to reopen STM32 serial port...", flush=True)
 
-                try:
-                    if ser is not None:
-                        ser.close()
-                except Exception:
-                    pass
+                # No STM32 to listen to: stop transmitting until it is back.
+                radar_off(radar)
 
-                time.sleep(1.0)
-                ser = open_stm_serial()
+                with radar["ser_lock"]:
+                    try:
+                        if ser is not None:
+                            ser.close()
+                    except Exception:
+                        pass
 
-            time.sleep(LOOP_DELAY_S)
+                    time.sleep(1.0)
+                    ser = open_stm_serial()
+                    radar["ser"] = ser
 
     except KeyboardInterrupt:
         print("\nStopped by user", flush=True)
@@ -321,7 +429,20 @@ def main():
     finally:
         print("Cleaning up radar_controlled.py", flush=True)
 
-        radar_proc = stop_radar(radar_proc)
+        if radar is not None:
+            radar_off(radar)
+
+        if acq_thread is not None:
+            ru.stop_acquisition(radar["stop_event"], acq_thread)
+
+        if proc_thread is not None:
+            proc_thread.join(timeout=2.0)
+
+        if radar is not None:
+            ru.save_clutter_map(radar["bg_state"])
+
+        if sdr is not None:
+            ru.stop_tx(sdr)
 
         if ser is not None:
             try:
@@ -13,8 +13,8 @@ True reflected-target FMCW radar for Pluto Plus, running on Raspberry Pi 3.
 
 Changes from UDP version:
 - Outputs over USB serial instead of UDP
-- Keeps the same ASCII packet format:
-      range_m,angle_deg,quality\n
+- ASCII packet format, one group per detected target, strongest first:
+      range_m,angle_deg,quality,velocity_mps;range_m,...\n
 - Optimized for Raspberry Pi 3 CPU/RAM limits
 - Designed for a 16 GB Raspberry Pi microSD card setup
 
@@ -25,15 +25,17 @@ Hardware assumption:
 - STM32 appears on Pi as /dev/ttyACM0 or /dev/ttyUSB0
 
 Packet example sent to STM32:
-    2.431,-7.52,0.81\n
+    2.431,-7.52,0.81,-0.63;7.102,12.40,0.55,0.00\n
 """
 
 import time
 import numpy as np
-import adi
 import serial
 import os
 import glob
+import queue
+import threading
+import argparse
 
 
 # -------------------------------------------------
@@ -87,28 +89,127 @@ GUARD0_N = 256
 CHIRP_EDGE_GUARD = 64
 TX_FRAME_REPEATS = 64
 
+# Wait after loading the cyclic TX buffer. Samples from before TX was
+# running are also flushed by DISCARD_RX_READS.
+TX_SETTLE_S = 0.1
+
+# The radar daemon keeps RX streaming while off and never waits for TX.
+# Instead it drops blocks whose acquisition started before sdr.tx() returned
+# plus this much. The LO stays locked while off, so the cyclic buffer is on
+# the air within a few ms.
+TX_ON_SETTLE_S = 0.005
+
 # Acquisition settings optimized for Raspberry Pi 3.
 RX_BUF = 131072
 DISCARD_RX_READS = 2
+# Reads concatenated per block for the flattened-beat spectrum. The
+# range-Doppler map only uses the first read (see below), so it takes one.
 ACCUM_READS = 3
 CHIRPS_TO_AVG = 12
 
 # Sync.
 PEAK_THRESH_RATIO = 0.80
 
+# Sync tracking.
+# tx_cyclic_buffer keeps the frame alignment nearly fixed between blocks, so
+# after one full FFT correlation only a small window of lags around the last
+# offset is searched. A full re-acquisition runs when the tracked peak lands on
+# the window edge, its normalized correlation drops, or every
+# SYNC_REACQUIRE_PERIOD blocks as a safety net.
+SYNC_TRACK_ENABLED = True
+SYNC_TRACK_HALF_WINDOW = 48
+SYNC_TRACK_MAX_STEPS = 2
+SYNC_REFINE_MAX_STEPS = 16
+SYNC_MIN_QUALITY = 0.50
+SYNC_QUALITY_DROP_RATIO = 0.75
+SYNC_REACQUIRE_PERIOD = 100
+
 # True radar target search band.
 FB_MIN_HZ = 30.0
 FB_MAX_HZ = 3000.0
 
+# Beat-signal decimation.
+# The search band is a few kHz wide while FS is 2 MS/s, so the dechirped beat
+# is low-pass filtered and decimated before the spectrum. The filter is a
+# cascade of BEAT_CIC_ORDER boxcars of length BEAT_DECIM (a CIC filter), which
+# puts nulls on every frequency that would alias back onto the band.
+# BEAT_DECIM = 1 selects the original full-rate spectrum.
+BEAT_DECIM = 32
+BEAT_CIC_ORDER = 2
+BEAT_ZERO_PAD = 4
+
+# A second-order CIC droops and lets aliases through towards the edge of the
+# decimated band, so the search band is kept below this fraction of
+# FS / BEAT_DECIM (6.25 kHz at 32x). Wider bands need a smaller BEAT_DECIM.
+BEAT_BAND_MAX_FRACTION = 0.1
+BEAT_BAND_MAX_HZ = BEAT_BAND_MAX_FRACTION * FS / max(1, BEAT_DECIM)
+
+# Range-Doppler processing.
+# Chirps are kept separate: a range FFT per chirp, then a Doppler FFT across
+# DOPPLER_CHIRPS chirps, so each detection carries radial velocity. The chirp
+# repetition interval is one TX frame, giving +/- C / (4 * FC * Nframe / FS)
+# unambiguous velocity (about 20 m/s) and C / (2 * FC * DOPPLER_CHIRPS * Nframe / FS)
+# resolution (about 1.3 m/s with 32 chirps).
+# Separate sdr.rx() reads are not contiguous, so the chirps are taken from the
+# first read only and DOPPLER_CHIRPS is capped to what fits in RX_BUF.
+# RANGE_DOPPLER_ENABLED = False keeps the flattened-beat range spectrum.
+RANGE_DOPPLER_ENABLED = True
+DOPPLER_CHIRPS = 32
+DOPPLER_ZERO_PAD = 1
+
+# Cell-averaging CFAR detection.
+# Noise power at each cell is the mean of CFAR_TRAIN cells on each side,
+# past CFAR_GUARD guard cells. On the range-Doppler map the window runs along
+# the (wrapping) Doppler axis, because the range main lobe covers most of the
+# band at this sweep width. On a single spectrum it runs along range.
+# CFAR_SMALLEST_OF uses the quieter side only, so a strong neighbour (or the
+# zero-Doppler leakage) does not mask a weaker target.
+# Local maxima above threshold are reported, strongest first, up to
+# CFAR_MAX_TARGETS. CFAR_ENABLED = False reports the single strongest cell.
+CFAR_ENABLED = True
+CFAR_PFA = 1e-3
+CFAR_GUARD = 2
+CFAR_TRAIN = 6
+CFAR_SMALLEST_OF = True
+CFAR_MAX_TARGETS = 4
+
 # Quality / target detection thresholds.
 MIN_PEAK_TO_MEDIAN = 0.0
 MIN_COHERENCE = 0.0
 
-# Background subtraction.
+# Background subtraction (legacy, used when CLUTTER_ENABLED = False).
 BG_ALPHA = 0.0
 BG_INIT_FRAMES = 0
 BG_FREEZE_QUALITY = 0.999999
 
+# Clutter map.
+# Mean magnitude of every detection-map cell (range bin, and Doppler bin on
+# the range-Doppler map) per RX channel. With CFAR it is a per-cell noise
+# floor: a cell must also exceed CLUTTER_THRESHOLD_DB over its learned
+# clutter, so static returns from the hull and mount are not reported.
+# Clutter moves with the kayak, so on the range-Doppler map the floor only
+# applies within CLUTTER_MAX_SPEED_MPS of zero Doppler; a boat crossing at
+# constant speed stays in one cell and would otherwise be learned as clutter.
+# Without CFAR it is subtracted like the legacy background.
+# - Learns at CLUTTER_ALPHA per block after warm-up; during the first
+#   CLUTTER_WARMUP_BLOCKS blocks it is a running mean so it settles fast.
+# - Cells within CLUTTER_FREEZE_GUARD of a target confirmed by
+#   CLUTTER_CONFIRM_BLOCKS consecutive CFAR hits are not updated, so a slow
+#   or stopped target is not learned away.
+# - Saved to CLUTTER_MAP_FILE every CLUTTER_SAVE_PERIOD_S and on exit, and
+#   reloaded on start if the processing configuration still matches. Replay
+#   and the benchmarks neither save it nor, by default, load it, so a map
+#   learned on the desk never replaces the one learned on the water.
+CLUTTER_ENABLED = True
+CLUTTER_ALPHA = 0.02
+CLUTTER_THRESHOLD_DB = 10.0
+CLUTTER_MAX_SPEED_MPS = 1.5
+CLUTTER_WARMUP_BLOCKS = 20
+CLUTTER_CONFIRM_BLOCKS = 3
+CLUTTER_FREEZE_GUARD = 1
+CLUTTER_MAP_FILE = os.path.join(os.path.dirname(os.path.abspath(__file__)), "clutter_map.npz")
+CLUTTER_SAVE_PERIOD_S = 60.0
+
 # Send pacing.
 # 0.10 s = 10 packets per second max.
 # This is easier for the STM32 and Pi than 50 packets per second.
@@ -118,6 +219,74 @@ MIN_SEND_PERIOD_S = 0.05
 # Leave True while testing. Set False after it works.
 PRINT_PACKETS = True
 
+# Acquisition / processing pipeline.
+# When enabled, a worker thread keeps pulling Pluto buffers while the main
+# thread processes the previous block. Blocks are double buffered: one is
+# being filled while the other is processed. If processing falls behind, the
+# oldest waiting block is dropped so detections stay fresh.
+PIPELINE_ENABLED = True
+PIPELINE_QUEUE_DEPTH = 1
+PIPELINE_GET_TIMEOUT_S = 1.0
+
+# How often latency / packet rate statistics are printed.
+STATS_PERIOD_S = 5.0
+
+# Range profile stream.
+# Every RANGE_PROFILE_PERIOD_S the strongest return (over Doppler) of every
+# range bin is sent as an extra line so the STM32 can map all returns, not
+# just the detections:
+#     #P,seq,floor_half_db,start_cm,step_cm,HEX\n
+# HEX is, per bin, a level in 0.5 dB steps above the floor (first bin as
+# uint8, the rest as int8 deltas), followed by one int8 angle in degrees per
+# bin. Bins are max-pooled until the payload fits RANGE_PROFILE_MAX_BYTES.
+RANGE_PROFILE_ENABLED = False
+RANGE_PROFILE_PERIOD_S = 0.5
+RANGE_PROFILE_MAX_BYTES = 96
+RANGE_PROFILE_DYNAMIC_DB = 60.0
+
+# Processing stages timed in the statistics (and by radar_bench.py).
+STAGES = ("sync", "dechirp", "spectrum", "detection", "packet")
+
+# Recorded IQ.
+# --capture DIR writes every accumulated RX block to DIR/block_NNNNNN.npz
+# (r0, r1, t_acq, fs, fc); one block is about 6 MB. --replay DIR feeds those
+# files back through the same processing instead of the Pluto.
+CAPTURE_MAX_BLOCKS = 500
+REPLAY_LOOP = False
+
+# Runtime parameters.
+# Settings that can be read and changed while the radar runs, relayed by the
+# STM32 from the ESP32 UI:
+#     #S,id,value\n   set
+#     #G,id\n         get
+# Every request is answered with the value now in use:
+#     #V,id,value,status\n
+# status is PARAM_OK, PARAM_UNKNOWN (no such id) or PARAM_REJECTED (out of
+# range or inconsistent, the old value is kept). Gain and search band changes
+# alter the clutter map scale and layout, so the map is relearned.
+# Entries: id -> (setting, min, max, type, relearn clutter map)
+RADAR_PARAMS = {
+    0x00: ("TX_GAIN", -89.0, 0.0, float, True),
+    0x01: ("RX_GAIN0", 0.0, 71.0, float, True),
+    0x02: ("RX_GAIN1", 0.0, 71.0, float, True),
+    0x03: ("FB_MIN_HZ", 0.0, BEAT_BAND_MAX_HZ, float, True),
+    0x04: ("FB_MAX_HZ", 0.0, BEAT_BAND_MAX_HZ, float, True),
+    0x05: ("CFAR_PFA", 1e-9, 0.1, float, False),
+    0x06: ("CFAR_MAX_TARGETS", 1, 4, int, False),
+    0x07: ("CLUTTER_THRESHOLD_DB", 0.0, 40.0, float, False),
+    0x08: ("CLUTTER_ALPHA", 0.0, 1.0, float, False),
+    0x09: ("CLUTTER_MAX_SPEED_MPS", 0.0, 20.0, float, False),
+    0x0A: ("MIN_PEAK_TO_MEDIAN", 0.0, 1000.0, float, False),
+    0x0B: ("MIN_COHERENCE", 0.0, 1.0, float, False),
+    0x0C: ("MIN_SEND_PERIOD_S", 0.0, 5.0, float, False),
+    0x0D: ("RANGE_PROFILE_ENABLED", 0, 1, bool, False),
+    0x0E: ("RANGE_PROFILE_PERIOD_S", 0.1, 10.0, float, False),
+}
+
+PARAM_OK = 0
+PARAM_UNKNOWN = 1
+PARAM_REJECTED = 2
+
 
 # -------------------------------------------------
 # Signal generation helpers
@@ -216,8 +385,154 @@ def earliest_strong_peak_start_frame_aligned(
     return best_start
 
 
+def normalized_correlation(sig, ref, start):
+    """
+    Correlation magnitude of ref against sig at one lag, normalized to 0..1.
+    """
+    seg = sig[start:start + ref.size]
+
+    if seg.size != ref.size:
+        return 0.0
+
+    num = np.abs(np.vdot(ref, seg))
+    den = np.linalg.norm(ref) * np.linalg.norm(seg) + 1e-12
+
+    return float(num / den)
+
+
+def windowed_peak_start(sig, ref, center, half_window):
+    """
+    Direct correlation of ref over lags center-half_window..center+half_window.
+
+    Returns:
+        (best_start, on_edge) or (None, True) if the window does not fit.
+    """
+    lo = center - half_window
+    hi = center + half_window
+
+    if lo < 0 or hi + ref.size > sig.size:
+        return None, True
+
+    span = sig[lo:hi + ref.size]
+    lags = np.lib.stride_tricks.sliding_window_view(span, ref.size)
+    mag = np.abs(lags @ np.conjugate(ref))
+
+    k = int(np.argmax(mag))
+    on_edge = (k == 0) or (k == mag.size - 1)
+
+    return lo + k, on_edge
+
+
+def climb_to_peak_start(sig, ref, start, half_window, max_steps):
+    """
+    Hill-climbs the windowed correlation from start until the peak is inside
+    the search window.
+
+    Returns:
+        best start, or None if the peak was not found within max_steps windows.
+    """
+    center = start
+
+    for _ in range(max_steps):
+        best, on_edge = windowed_peak_start(sig, ref, center, half_window)
+
+        if best is None:
+            return None
+
+        if not on_edge:
+            return best
+
+        center = best
+
+    return None
+
+
+def new_sync_state():
+    return {
+        "start": None,
+        "ref_quality": 0.0,
+        "quality": 0.0,
+        "since_acquire": 0,
+        "tracked": 0,
+        "reacquired": 0,
+    }
+
+
+def track_frame_start(sig, ref, nframe, sync_state):
+    """
+    Frame sync with tracking.
+
+    Searches a small window around the previous frame offset and only falls
+    back to the full FFT correlation in earliest_strong_peak_start_frame_aligned()
+    when the tracked peak is lost.
+    """
+    prev = sync_state["start"]
+
+    if (
+        SYNC_TRACK_ENABLED
+        and prev is not None
+        and sync_state["since_acquire"] < SYNC_REACQUIRE_PERIOD
+    ):
+        center = prev
+
+        # Frames repeat every nframe samples, so move the window one frame
+        # later if it would run off the start of the block.
+        if center - SYNC_TRACK_HALF_WINDOW < 0:
+            center += nframe
+
+        start = climb_to_peak_start(
+            sig, ref, center, SYNC_TRACK_HALF_WINDOW, SYNC_TRACK_MAX_STEPS
+        )
+
+        if start is not None:
+            q = normalized_correlation(sig, ref, start)
+
+            if q >= SYNC_MIN_QUALITY and q >= SYNC_QUALITY_DROP_RATIO * sync_state["ref_quality"]:
+                sync_state["start"] = start % nframe
+                sync_state["quality"] = q
+                sync_state["since_acquire"] += 1
+                sync_state["tracked"] += 1
+                return sync_state["start"]
+
+    start = earliest_strong_peak_start_frame_aligned(
+        sig,
+        ref,
+        nframe=nframe,
+        thresh_ratio=PEAK_THRESH_RATIO,
+        min_start=0
+    )
+
+    if start is None:
+        sync_state["start"] = None
+        return None
+
+    # The frame-aligned search only guarantees a start inside the strong
+    # region of the correlation. Refine it to the actual peak so the next
+    # block can be tracked from there.
+    center = start
+    if center - SYNC_TRACK_HALF_WINDOW < 0:
+        center += nframe
+
+    refined = climb_to_peak_start(
+        sig, ref, center, SYNC_TRACK_HALF_WINDOW, SYNC_REFINE_MAX_STEPS
+    )
+
+    if refined is not None:
+        start = refined % nframe
+
+    q = normalized_correlation(sig, ref, start)
+
+    sync_state["start"] = start
+    sync_state["quality"] = q
+    sync_state["ref_quality"] = q
+    sync_state["since_acquire"] = 0
+    sync_state["reacquired"] += 1
+
+    return start
+
+
 def coherence_metric(x):
-    x = x.astype(np.complex128, copy=False)
+    x = x.astype(np.complex64, copy=False)
     x = x - np.mean(x)
 
     if x.size < 2:
@@ -259,19 +574,183 @@ def beat_spectrum(beat, fs, fmin_hz, fmax_hz):
     return freqs[band], X[band], mag[band]
 
 
+def cic_decimate(x, decim, order):
+    """
+    Boxcar-cascade (CIC) low-pass and decimate along the last axis.
+
+    Each stage is a length-decim moving average; the last stage is folded
+    into the decimation as a block mean.
+    """
+    if decim <= 1:
+        return x
+
+    for _ in range(order - 1):
+        c = np.cumsum(x, axis=-1)
+        y = np.empty_like(c)
+        y[..., :decim] = c[..., :decim] / np.arange(1, decim + 1, dtype=np.float32)
+        y[..., decim:] = (c[..., decim:] - c[..., :-decim]) / np.float32(decim)
+        x = y
+
+    n = x.shape[-1] // decim
+    x = x[..., :n * decim]
+
+    return x.reshape(x.shape[:-1] + (n, decim)).mean(axis=-1)
+
+
+# Precomputed decimated-spectrum plans, keyed by beat length.
+_BEAT_PLANS = {}
+
+
+def get_beat_plan(nbeat, fs, fmin_hz, fmax_hz):
+    """
+    Window, FFT size and band bins for a decimated beat of nbeat samples.
+
+    Built once per beat length and reused every frame.
+    """
+    key = (nbeat, fs, fmin_hz, fmax_hz, BEAT_DECIM, BEAT_CIC_ORDER, BEAT_ZERO_PAD)
+
+    plan = _BEAT_PLANS.get(key)
+    if plan is not None:
+        return plan
+
+    decim = max(1, int(BEAT_DECIM))
+    fs_dec = fs / decim
+    n_dec = nbeat // decim
+
+    nfft = next_pow2(n_dec * BEAT_ZERO_PAD)
+    freqs = np.fft.fftfreq(nfft, d=1.0 / fs_dec)
+    band = np.where((freqs >= fmin_hz) & (freqs <= fmax_hz))[0]
+
+    plan = {
+        "decim": decim,
+        "n_dec": n_dec,
+        "nfft": nfft,
+        "window": np.hanning(n_dec).astype(np.float32),
+        "band": band,
+        "freqs": freqs[band],
+    }
+
+    _BEAT_PLANS[key] = plan
+
+    return plan
+
+
+def get_doppler_plan(nchirps, nframe, fs):
+    """
+    Window and velocity axis for a Doppler FFT across nchirps chirps spaced
+    one TX frame apart.
+    """
+    key = ("doppler", nchirps, nframe, fs, DOPPLER_ZERO_PAD)
+
+    plan = _BEAT_PLANS.get(key)
+    if plan is not None:
+        return plan
+
+    nfft = next_pow2(nchirps * DOPPLER_ZERO_PAD)
+    pri = nframe / fs
+
+    fd = np.fft.fftshift(np.fft.fftfreq(nfft, d=pri))
+
+    # Positive Doppler is a shrinking delay. Report range rate, so closing
+    # targets are negative.
+    wavelength = C / FC
+    vel = -fd * wavelength / 2.0
+
+    plan = {
+        "nfft": nfft,
+        "window": np.hanning(nchirps).astype(np.float32),
+        "vel": vel,
+    }
+
+    _BEAT_PLANS[key] = plan
+
+    return plan
+
+
+def clear_beat_plans():
+    _BEAT_PLANS.clear()
+
+
+def range_doppler_map(beats, nframe, fs, fmin_hz, fmax_hz):
+    """
+    Range-Doppler map of one channel.
+
+    beats is a (chirps, samples) array from dechirp_block(). Each chirp is
+    decimated and range transformed, then the band bins are transformed
+    across chirps.
+
+    Returns:
+        beat frequency axis (range),
+        range rate axis in m/s,
+        complex map shaped (doppler, range)
+    """
+    x = beats.astype(np.complex64, copy=False)
+
+    rplan = get_beat_plan(x.shape[-1], fs, fmin_hz, fmax_hz)
+    dplan = get_doppler_plan(x.shape[0], nframe, fs)
+
+    x = cic_decimate(x, rplan["decim"], BEAT_CIC_ORDER)
+
+    R = np.fft.fft(x * rplan["window"], rplan["nfft"], axis=-1)[:, rplan["band"]]
+
+    RD = np.fft.fft(R * dplan["window"][:, None], dplan["nfft"], axis=0)
+    RD = np.fft.fftshift(RD, axes=0)
+
+    return rplan["freqs"], dplan["vel"], RD
+
+
+def parabolic_peak_offset(y, i):
+    """
+    Sub-bin offset of the peak at y[i] from a parabola through its neighbours.
+    """
+    if i <= 0 or i >= len(y) - 1:
+        return 0.0
+
+    a = float(y[i - 1])
+    b = float(y[i])
+    c = float(y[i + 1])
+
+    den = a - 2.0 * b + c
+    if den >= 0.0:
+        return 0.0
+
+    return float(np.clip(0.5 * (a - c) / den, -0.5, 0.5))
+
+
+def beat_spectrum_decimated(beat, fs, fmin_hz, fmax_hz):
+    """
+    Same outputs as beat_spectrum(), computed on a decimated complex64 beat.
+
+    Returns:
+        frequency axis,
+        complex spectrum,
+        magnitude spectrum
+    """
+    x = beat.astype(np.complex64, copy=False)
+
+    plan = get_beat_plan(x.size, fs, fmin_hz, fmax_hz)
+
+    x = cic_decimate(x, plan["decim"], BEAT_CIC_ORDER)
+    x = x - np.mean(x)
+
+    X = np.fft.fft(x * plan["window"], plan["nfft"])[plan["band"]]
+
+    return plan["freqs"], X, np.abs(X)
+
+
 # -------------------------------------------------
 # Background subtraction helpers
 # -------------------------------------------------
 
 def update_background(bg, mag, alpha):
-    if bg is None:
+    if bg is None or bg.shape != mag.shape:
         return mag.copy()
 
     return alpha * bg + (1.0 - alpha) * mag
 
 
 def subtract_background(mag, bg):
-    if bg is None:
+    if bg is None or bg.shape != mag.shape:
         return mag.copy()
 
     out = mag - bg
@@ -280,12 +759,187 @@ def subtract_background(mag, bg):
     return out
 
 
+def new_background_state(load=True, persist=True):
+    """
+    Background / clutter map state passed to process_block().
+
+    load reads the saved clutter map; persist lets save_clutter_map() write
+    it back. Only live radar input should persist.
+    """
+    bg_state = {
+        "bg0": None,
+        "bg1": None,
+        "init_count": 0,
+        "hits": None,
+        "t_saved": time.monotonic(),
+        "persist": persist,
+    }
+
+    if load and CLUTTER_ENABLED:
+        load_clutter_map(bg_state)
+
+    return bg_state
+
+
+def clutter_config():
+    """
+    Settings that change the detection map layout or scale. A saved clutter
+    map is only reused if these match.
+    """
+    return np.array([
+        FS, FC, B_SWEEP, T_CHIRP, FB_MIN_HZ, FB_MAX_HZ,
+        BEAT_DECIM, BEAT_CIC_ORDER, BEAT_ZERO_PAD,
+        float(RANGE_DOPPLER_ENABLED), DOPPLER_CHIRPS, DOPPLER_ZERO_PAD,
+        RX_GAIN0, RX_GAIN1, TX_GAIN,
+    ], dtype=np.float64)
+
+
+def load_clutter_map(bg_state):
+    if not os.path.exists(CLUTTER_MAP_FILE):
+        return
+
+    try:
+        data = np.load(CLUTTER_MAP_FILE)
+
+        if not np.array_equal(data["config"], clutter_config()):
+            print("Saved clutter map is for different settings, relearning", flush=True)
+            return
+
+        bg_state["bg0"] = data["bg0"]
+        bg_state["bg1"] = data["bg1"]
+        bg_state["init_count"] = CLUTTER_WARMUP_BLOCKS
+
+        print(f"Loaded clutter map {bg_state['bg0'].shape} from {CLUTTER_MAP_FILE}", flush=True)
+
+    except Exception as e:
+        print("Could not load clutter map:", repr(e), flush=True)
+
+
+def save_clutter_map(bg_state):
+    """
+    Writes the clutter map once it has warmed up. Written to a temporary
+    file first so a power cut cannot leave a truncated map behind.
+    """
+    if not CLUTTER_ENABLED or bg_state is None or bg_state["bg0"] is None:
+        return
+
+    if not bg_state["persist"]:
+        return
+
+    if bg_state["init_count"] < CLUTTER_WARMUP_BLOCKS:
+        return
+
+    tmp = CLUTTER_MAP_FILE + ".tmp.npz"
+
+    try:
+        np.savez(tmp, bg0=bg_state["bg0"], bg1=bg_state["bg1"], config=clutter_config())
+        os.replace(tmp, CLUTTER_MAP_FILE)
+    except Exception as e:
+        print("Could not save clutter map:", repr(e), flush=True)
+
+    bg_state["t_saved"] = time.monotonic()
+
+
+def clutter_floor(bg_state, det):
+    """
+    Clutter magnitude map for the detection map in det, zero outside the
+    clutter Doppler band, or None if there is no map of this shape yet.
+    """
+    shape = det["mag0"].shape
+
+    if bg_state["bg0"] is None or bg_state["bg0"].shape != shape:
+        return None
+
+    clutter = np.atleast_2d(bg_state["bg0"] + bg_state["bg1"])
+
+    vel = det["vel"]
+    if vel.size > 1:
+        clutter = clutter * (np.abs(vel) <= CLUTTER_MAX_SPEED_MPS)[:, None]
+
+    return clutter
+
+
+def dilate_cells(mask, guard):
+    """
+    Grow a (doppler, range) mask by guard cells on each axis (Doppler wraps).
+    """
+    out = mask.copy()
+
+    for _ in range(guard):
+        grown = out.copy()
+        grown[:, 1:] |= out[:, :-1]
+        grown[:, :-1] |= out[:, 1:]
+        if out.shape[0] > 1:
+            grown |= np.roll(out, 1, axis=0)
+            grown |= np.roll(out, -1, axis=0)
+        out = grown
+
+    return out
+
+
+def update_clutter_map(bg_state, det, target_cells):
+    """
+    Learn the clutter map from this block's magnitudes, except around
+    confirmed targets.
+
+    target_cells is the list of (doppler, range) CFAR hits of this block.
+    """
+    mag0 = det["mag0"]
+    mag1 = det["mag1"]
+
+    if bg_state["bg0"] is None or bg_state["bg0"].shape != mag0.shape:
+        bg_state["bg0"] = mag0.copy()
+        bg_state["bg1"] = mag1.copy()
+        bg_state["init_count"] = 1
+        bg_state["hits"] = None
+        return
+
+    shape2d = np.atleast_2d(mag0).shape
+
+    hit = np.zeros(shape2d, dtype=bool)
+    for d, k in target_cells:
+        hit[d, k] = True
+
+    hit = dilate_cells(hit, CLUTTER_FREEZE_GUARD)
+
+    if bg_state["hits"] is None or bg_state["hits"].shape != shape2d:
+        bg_state["hits"] = np.zeros(shape2d, dtype=np.int32)
+
+    hits = bg_state["hits"]
+    hits[hit] += 1
+    hits[~hit] = 0
+
+    n = bg_state["init_count"]
+
+    if n < CLUTTER_WARMUP_BLOCKS:
+        # Running mean while warming up; everything seen is clutter.
+        rate = max(1.0 / (n + 1), CLUTTER_ALPHA)
+        learn = np.ones(shape2d, dtype=bool)
+        bg_state["init_count"] = n + 1
+    else:
+        rate = CLUTTER_ALPHA
+        learn = ~dilate_cells(hits >= CLUTTER_CONFIRM_BLOCKS, CLUTTER_FREEZE_GUARD)
+
+    learn = learn.reshape(mag0.shape)
+
+    bg_state["bg0"] = np.where(learn, (1.0 - rate) * bg_state["bg0"] + rate * mag0, bg_state["bg0"])
+    bg_state["bg1"] = np.where(learn, (1.0 - rate) * bg_state["bg1"] + rate * mag1, bg_state["bg1"])
+
+    if bg_state["persist"] and time.monotonic() - bg_state["t_saved"] >= CLUTTER_SAVE_PERIOD_S:
+        save_clutter_map(bg_state)
+
+
 def detect_target_bin_with_bg(beat0, beat1, fs, fmin_hz, fmax_hz, bg0, bg1):
     """
     Detect target beat bin using background-subtracted combined RX magnitude.
     """
-    freqs0, X0, mag0 = beat_spectrum(beat0, fs, fmin_hz, fmax_hz)
-    freqs1, X1, mag1 = beat_spectrum(beat1, fs, fmin_hz, fmax_hz)
+    if BEAT_DECIM > 1:
+        spectrum = beat_spectrum_decimated
+    else:
+        spectrum = beat_spectrum
+
+    freqs0, X0, mag0 = spectrum(beat0, fs, fmin_hz, fmax_hz)
+    freqs1, X1, mag1 = spectrum(beat1, fs, fmin_hz, fmax_hz)
 
     if freqs0.size < 10:
         return None
@@ -321,61 +975,305 @@ def detect_target_bin_with_bg(beat0, beat1, fs, fmin_hz, fmax_hz, bg0, bg1):
         "mag1_sub": mag1_sub,
         "mag_sum_sub": mag_sum_sub,
         "p2m": p2m,
+        "map0": X0[None, :],
+        "map1": X1[None, :],
+        "vel": np.zeros(1),
     }
 
 
-# -------------------------------------------------
-# Pluto helpers
-# -------------------------------------------------
+def interpolate_cell(mag, freqs, vel, d, k):
+    """
+    Beat frequency and velocity of map cell (d, k), refined by parabolic
+    interpolation along each axis.
+    """
+    if freqs.size > 1:
+        df = freqs[1] - freqs[0]
+        fb = float(freqs[k] + parabolic_peak_offset(mag[d, :], k) * df)
+    else:
+        fb = float(freqs[k])
 
-def setup_pluto():
-    print("Connecting to Pluto Plus at", URI)
+    if vel.size > 1:
+        dv = vel[1] - vel[0]
+        velocity = float(vel[d] + parabolic_peak_offset(mag[:, k], d) * dv)
+    else:
+        velocity = 0.0
 
-    sdr = adi.ad9361(uri=URI)
+    return fb, velocity
 
-    sdr.rx_enabled_channels = [0, 1]
-    sdr.tx_enabled_channels = [0]
 
-    sdr.sample_rate = int(FS)
-    sdr.rx_rf_bandwidth = int(RF_BW)
-    sdr.tx_rf_bandwidth = int(RF_BW)
+def detect_target_rd_with_bg(beats0, beats1, nframe, fs, fmin_hz, fmax_hz, bg0, bg1):
+    """
+    Detect the strongest range-Doppler cell using background-subtracted
+    combined RX magnitude.
+    """
+    freqs, vel, RD0 = range_doppler_map(beats0, nframe, fs, fmin_hz, fmax_hz)
+    _, _, RD1 = range_doppler_map(beats1, nframe, fs, fmin_hz, fmax_hz)
 
-    sdr.rx_lo = int(FC)
-    sdr.tx_lo = int(FC)
+    if freqs.size < 2:
+        return None
 
-    sdr.gain_control_mode_chan0 = "manual"
-    sdr.gain_control_mode_chan1 = "manual"
+    mag0 = np.abs(RD0)
+    mag1 = np.abs(RD1)
 
-    sdr.rx_hardwaregain_chan0 = float(RX_GAIN0)
-    sdr.rx_hardwaregain_chan1 = float(RX_GAIN1)
+    mag0_sub = subtract_background(mag0, bg0)
+    mag1_sub = subtract_background(mag1, bg1)
 
-    sdr.tx_hardwaregain_chan0 = float(TX_GAIN)
+    mag_sum_sub = mag0_sub + mag1_sub
 
-    sdr.rx_buffer_size = int(RX_BUF)
-    sdr.tx_cyclic_buffer = True
+    d, k = np.unravel_index(int(np.argmax(mag_sum_sub)), mag_sum_sub.shape)
 
-    try:
-        sdr._rxadc.set_kernel_buffers_count(1)
-    except Exception:
-        pass
+    fb, velocity = interpolate_cell(mag_sum_sub, freqs, vel, d, k)
 
-    print("Pluto setup complete")
+    peak = float(mag_sum_sub[d, k] + 1e-12)
+    med = float(np.median(mag_sum_sub) + 1e-12)
 
-    return sdr
+    if med > 0:
+        p2m = peak / med
+    else:
+        p2m = 0.0
 
+    return {
+        "fb_hz": fb,
+        "velocity_mps": velocity,
+        "bin_index": int(k),
+        "doppler_index": int(d),
+        "freqs": freqs,
+        "vel": vel,
+        "X0": RD0[d],
+        "X1": RD1[d],
+        "mag0": mag0,
+        "mag1": mag1,
+        "mag0_sub": mag0_sub,
+        "mag1_sub": mag1_sub,
+        "mag_sum_sub": mag_sum_sub,
+        "p2m": p2m,
+        "map0": RD0,
+        "map1": RD1,
+    }
 
-def measure_block(sdr):
-    rx = sdr.rx()
 
-    if isinstance(rx, (list, tuple)) and len(rx) == 2:
-        return np.asarray(rx[0]), np.asarray(rx[1])
+# -------------------------------------------------
+# CA-CFAR detection
+# -------------------------------------------------
 
-    rx = np.asarray(rx)
+def cfar_window_sums(power, guard, train, wrap):
+    """
+    Sums and cell counts of the leading and lagging training windows of every
+    cell along the last axis, from a cumulative sum.
 
-    if rx.ndim == 2 and rx.shape[0] == 2:
-        return rx[0], rx[1]
+    Returns:
+        (lead_sum, lead_n, lag_sum, lag_n)
+    """
+    n = power.shape[-1]
+    half = guard + train
 
-    if rx.ndim == 2 and rx.shape[1] == 2:
+    if wrap:
+        idx = np.arange(-half, n + half) % n
+        p = power[..., idx]
+        valid = np.ones(n + 2 * half)
+    else:
+        pad = [(0, 0)] * (power.ndim - 1) + [(half, half)]
+        p = np.pad(power, pad)
+        valid = np.pad(np.ones(n), (half, half))
+
+    c = np.zeros(p.shape[:-1] + (p.shape[-1] + 1,))
+    c[..., 1:] = np.cumsum(p, axis=-1)
+
+    cn = np.zeros(valid.size + 1)
+    cn[1:] = np.cumsum(valid)
+
+    i = np.arange(n)
+    lag0 = i + half + guard + 1
+
+    lead_sum = c[..., i + train] - c[..., i]
+    lag_sum = c[..., lag0 + train] - c[..., lag0]
+
+    lead_n = cn[i + train] - cn[i]
+    lag_n = cn[lag0 + train] - cn[lag0]
+
+    return lead_sum, lead_n, lag_sum, lag_n
+
+
+def ca_cfar(power):
+    """
+    Cell-averaging CFAR threshold on a (doppler, range) power map.
+
+    Returns:
+        threshold map,
+        noise estimate map
+    """
+    if power.shape[0] > 1:
+        # Train along Doppler: work on the transposed map.
+        p = power.T
+        wrap = True
+    else:
+        p = power
+        wrap = False
+
+    lead_sum, lead_n, lag_sum, lag_n = cfar_window_sums(p, CFAR_GUARD, CFAR_TRAIN, wrap)
+
+    lead_mean = lead_sum / np.maximum(lead_n, 1.0)
+    lag_mean = lag_sum / np.maximum(lag_n, 1.0)
+
+    if CFAR_SMALLEST_OF:
+        use_lead = (lead_n > 0) & ((lead_mean <= lag_mean) | (lag_n == 0))
+        noise = np.where(use_lead, lead_mean, lag_mean)
+        n_train = np.where(use_lead, lead_n, lag_n) + np.zeros_like(noise)
+    else:
+        n_train = lead_n + lag_n + np.zeros_like(lead_sum)
+        noise = (lead_sum + lag_sum) / np.maximum(n_train, 1.0)
+
+    n_train = np.maximum(n_train, 1.0)
+
+    # Square-law detector: Pfa = (1 + alpha / N) ** -N. For smallest-of this
+    # is a close (slightly optimistic) approximation.
+    alpha = n_train * (CFAR_PFA ** (-1.0 / n_train) - 1.0)
+
+    threshold = alpha * noise
+
+    if power.shape[0] > 1:
+        return threshold.T, noise.T
+
+    return threshold, noise
+
+
+def local_maxima(p):
+    """
+    Cells not smaller than any of their 8 neighbours (Doppler wraps).
+    """
+    padded = np.pad(p, ((0, 0), (1, 1)), constant_values=-np.inf)
+
+    peak = np.ones(p.shape, dtype=bool)
+
+    for dd in (-1, 0, 1):
+        rolled = np.roll(padded, dd, axis=0) if p.shape[0] > 1 else padded
+
+        for dr in (-1, 0, 1):
+            if dd == 0 and dr == 0:
+                continue
+            peak &= p >= rolled[:, 1 + dr:1 + dr + p.shape[1]]
+
+    return peak
+
+
+def cfar_detect_targets(det, q_avg, clutter=None):
+    """
+    CA-CFAR detections on the background-subtracted map in det.
+
+    clutter, if given, is a clutter power map of the same shape: cells must
+    also clear it by CLUTTER_THRESHOLD_DB, and SNR is taken against the larger
+    of the two noise estimates.
+
+    Returns:
+        list of (range_m, angle_deg, quality, velocity_mps, snr_db),
+        strongest first, at most CFAR_MAX_TARGETS long
+    """
+    mag = np.atleast_2d(det["mag_sum_sub"])
+    power = mag.astype(np.float64) ** 2
+
+    threshold, noise = ca_cfar(power)
+
+    if clutter is not None:
+        clutter = np.atleast_2d(clutter)
+        threshold = np.maximum(threshold, clutter * 10.0 ** (CLUTTER_THRESHOLD_DB / 10.0))
+        noise = np.maximum(noise, clutter)
+
+    hits = (power > threshold) & local_maxima(power)
+    idx = np.flatnonzero(hits)
+
+    det["target_cells"] = []
+
+    if idx.size == 0:
+        return []
+
+    snr = power.flat[idx] / (noise.flat[idx] + 1e-20)
+    order = np.argsort(snr)[::-1][:CFAR_MAX_TARGETS]
+
+    targets = []
+
+    for i in order:
+        d, k = np.unravel_index(int(idx[i]), power.shape)
+
+        det["target_cells"].append((int(d), int(k)))
+
+        fb, velocity = interpolate_cell(mag, det["freqs"], det["vel"], d, k)
+
+        range_m = two_way_range_from_fb(fb, B_SWEEP, T_CHIRP)
+
+        angle_deg = estimate_angle_from_target_bin(
+            det["map0"][d],
+            det["map1"][d],
+            k,
+            D_RX,
+            FC
+        )
+
+        snr_lin = float(snr[i])
+
+        quality = 0.5 * min(snr_lin / 100.0, 1.0) + 0.5 * min(q_avg / 0.5, 1.0)
+        quality = float(np.clip(quality, 0.0, 1.0))
+
+        targets.append((range_m, angle_deg, quality, velocity, 10.0 * np.log10(snr_lin)))
+
+    return targets
+
+
+# -------------------------------------------------
+# Pluto helpers
+# -------------------------------------------------
+
+def setup_pluto():
+    # Imported here so the processing code can be loaded (radar_bench.py)
+    # on machines without libiio.
+    import adi
+
+    print("Connecting to Pluto Plus at", URI)
+
+    sdr = adi.ad9361(uri=URI)
+
+    sdr.rx_enabled_channels = [0, 1]
+    sdr.tx_enabled_channels = [0]
+
+    sdr.sample_rate = int(FS)
+    sdr.rx_rf_bandwidth = int(RF_BW)
+    sdr.tx_rf_bandwidth = int(RF_BW)
+
+    sdr.rx_lo = int(FC)
+    sdr.tx_lo = int(FC)
+
+    sdr.gain_control_mode_chan0 = "manual"
+    sdr.gain_control_mode_chan1 = "manual"
+
+    sdr.rx_hardwaregain_chan0 = float(RX_GAIN0)
+    sdr.rx_hardwaregain_chan1 = float(RX_GAIN1)
+
+    sdr.tx_hardwaregain_chan0 = float(TX_GAIN)
+
+    sdr.rx_buffer_size = int(RX_BUF)
+    sdr.tx_cyclic_buffer = True
+
+    try:
+        sdr._rxadc.set_kernel_buffers_count(1)
+    except Exception:
+        pass
+
+    print("Pluto setup complete")
+
+    return sdr
+
+
+def measure_block(sdr):
+    rx = sdr.rx()
+
+    if isinstance(rx, (list, tuple)) and len(rx) == 2:
+        return np.asarray(rx[0]), np.asarray(rx[1])
+
+    rx = np.asarray(rx)
+
+    if rx.ndim == 2 and rx.shape[0] == 2:
+        return rx[0], rx[1]
+
+    if rx.ndim == 2 and rx.shape[1] == 2:
         return rx[:, 0], rx[:, 1]
 
     raise RuntimeError(f"Unexpected RX shape: {rx.shape}")
@@ -393,30 +1291,260 @@ def build_tx_frame():
     return pre, chirp, frame, tx_wave
 
 
-def start_tx(sdr, tx_wave):
+def start_tx(sdr, tx_wave, settle_s=TX_SETTLE_S):
     try:
         sdr.tx_destroy_buffer()
     except Exception:
         pass
 
     sdr.tx(tx_wave)
-    time.sleep(0.1)
 
+    if settle_s > 0.0:
+        time.sleep(settle_s)
+
+
+def stop_tx(sdr):
+    try:
+        sdr.tx_destroy_buffer()
+    except Exception:
+        pass
+
+
+# -------------------------------------------------
+# Runtime parameters
+# -------------------------------------------------
+
+def get_param(param_id):
+    """
+    Current value of a RADAR_PARAMS entry as a float, or None if unknown.
+    """
+    entry = RADAR_PARAMS.get(param_id)
+
+    if entry is None:
+        return None
+
+    return float(globals()[entry[0]])
+
+
+def apply_sdr_gains(sdr):
+    """
+    Pushes the gain settings to the Pluto. Hardware gains are plain IIO
+    attributes, so this does not disturb the running buffers.
+    """
+    if sdr is None or is_replay_source(sdr):
+        return
+
+    sdr.rx_hardwaregain_chan0 = float(RX_GAIN0)
+    sdr.rx_hardwaregain_chan1 = float(RX_GAIN1)
+    sdr.tx_hardwaregain_chan0 = float(TX_GAIN)
+
+
+def set_param(param_id, value, sdr=None, bg_state=None):
+    """
+    Applies one RADAR_PARAMS entry live.
+
+    Returns:
+        PARAM_OK, PARAM_UNKNOWN or PARAM_REJECTED
+    """
+    entry = RADAR_PARAMS.get(param_id)
+
+    if entry is None:
+        return PARAM_UNKNOWN
+
+    name, vmin, vmax, kind, relearn = entry
+
+    if not np.isfinite(value) or value < vmin or value > vmax:
+        return PARAM_REJECTED
+
+    new = kind(round(value)) if kind is not float else float(value)
+
+    if name == "FB_MIN_HZ" and new >= FB_MAX_HZ:
+        return PARAM_REJECTED
+
+    if name == "FB_MAX_HZ" and new <= FB_MIN_HZ:
+        return PARAM_REJECTED
+
+    if globals()[name] == new:
+        return PARAM_OK
+
+    globals()[name] = new
+
+    if name in ("TX_GAIN", "RX_GAIN0", "RX_GAIN1"):
+        apply_sdr_gains(sdr)
+
+    if name in ("FB_MIN_HZ", "FB_MAX_HZ"):
+        clear_beat_plans()
+
+    if relearn and bg_state is not None:
+        bg_state["bg0"] = None
+        bg_state["bg1"] = None
+        bg_state["init_count"] = 0
+        bg_state["hits"] = None
+
+    print(f"Parameter {name} = {new}", flush=True)
+
+    return PARAM_OK
+
+
+def parse_param_command(line):
+    """
+    Parses "#S,id,value" or "#G,id".
+
+    Returns:
+        ("S", id, value), ("G", id, None) or None
+    """
+    fields = line.strip().split(",")
+
+    try:
+        if fields[0] == "#S" and len(fields) == 3:
+            return "S", int(fields[1]), float(fields[2])
+
+        if fields[0] == "#G" and len(fields) == 2:
+            return "G", int(fields[1]), None
 
-def acquire_accumulated_rx(sdr):
-    for _ in range(DISCARD_RX_READS):
+    except ValueError:
+        pass
+
+    return None
+
+
+def handle_param_command(cmd, sdr=None, bg_state=None):
+    """
+    Runs a parsed parameter command and returns the "#V" reply line.
+    """
+    op, param_id, value = cmd
+
+    if op == "S":
+        status = set_param(param_id, value, sdr, bg_state)
+    elif param_id in RADAR_PARAMS:
+        status = PARAM_OK
+    else:
+        status = PARAM_UNKNOWN
+
+    current = get_param(param_id)
+    if current is None:
+        current = 0.0
+
+    return f"#V,{param_id},{current:.6g},{status}\n"
+
+
+def block_reads():
+    """
+    Pluto reads making up one block: only what process_block() uses.
+    """
+    return 1 if RANGE_DOPPLER_ENABLED else ACCUM_READS
+
+
+def acquire_accumulated_rx(sdr, discard_reads=DISCARD_RX_READS):
+    if is_replay_source(sdr):
+        return replay_next_block(sdr)
+
+    for _ in range(discard_reads):
         _ = measure_block(sdr)
 
     acc0 = []
     acc1 = []
 
-    for _ in range(ACCUM_READS):
+    for _ in range(block_reads()):
         a0, a1 = measure_block(sdr)
         acc0.append(a0)
         acc1.append(a1)
 
-    r0 = np.concatenate(acc0)
-    r1 = np.concatenate(acc1)
+    # complex64 halves memory and FFT cost on the Pi; the Pluto ADC is only
+    # 12 bits so no precision is lost.
+    if len(acc0) == 1:
+        r0 = acc0[0].astype(np.complex64, copy=False)
+        r1 = acc1[0].astype(np.complex64, copy=False)
+    else:
+        r0 = np.concatenate(acc0).astype(np.complex64, copy=False)
+        r1 = np.concatenate(acc1).astype(np.complex64, copy=False)
+
+    return r0, r1
+
+
+# -------------------------------------------------
+# Recorded IQ capture / replay
+# -------------------------------------------------
+
+def new_capture(directory):
+    os.makedirs(directory, exist_ok=True)
+
+    return {
+        "dir": directory,
+        "count": 0,
+    }
+
+
+def capture_block(capture, block):
+    """
+    Write one accumulated RX block to the capture directory.
+    """
+    if capture is None or capture["count"] >= CAPTURE_MAX_BLOCKS:
+        return
+
+    path = os.path.join(capture["dir"], f"block_{capture['count']:06d}.npz")
+
+    np.savez(
+        path,
+        r0=block["r0"],
+        r1=block["r1"],
+        t_acq=block["t_acq"],
+        fs=FS,
+        fc=FC,
+    )
+
+    capture["count"] += 1
+
+    if capture["count"] == CAPTURE_MAX_BLOCKS:
+        print(f"Capture limit reached ({CAPTURE_MAX_BLOCKS} blocks)", flush=True)
+
+
+def open_replay(path):
+    """
+    Replay source standing in for the Pluto: a single .npz block or a
+    directory of them, in file name order.
+    """
+    if os.path.isdir(path):
+        files = sorted(glob.glob(os.path.join(path, "*.npz")))
+    else:
+        files = [path]
+
+    if not files:
+        raise RuntimeError(f"No .npz blocks in {path}")
+
+    print(f"Replaying {len(files)} blocks from {path}")
+
+    return {
+        "replay_files": files,
+        "index": 0,
+        "loop": REPLAY_LOOP,
+    }
+
+
+def is_replay_source(sdr):
+    return isinstance(sdr, dict) and "replay_files" in sdr
+
+
+def replay_next_block(replay):
+    """
+    Next recorded block as (r0, r1). Raises EOFError at the end of the
+    recording unless looping.
+    """
+    files = replay["replay_files"]
+
+    if replay["index"] >= len(files):
+        if not replay["loop"]:
+            raise EOFError("End of replay")
+        replay["index"] = 0
+
+    data = np.load(files[replay["index"]])
+    replay["index"] += 1
+
+    if "fs" in data and float(data["fs"]) != FS:
+        print(f"Warning: block recorded at FS={float(data['fs']):.0f}", flush=True)
+
+    r0 = data["r0"].astype(np.complex64, copy=False)
+    r1 = data["r1"].astype(np.complex64, copy=False)
 
     return r0, r1
 
@@ -501,29 +1629,24 @@ def estimate_angle_from_target_bin(X0, X1, bin_index, d_rx, fc):
 # Main processing
 # -------------------------------------------------
 
-def process_once(sdr, pre, chirp, frame, bg_state):
+def dechirp_block(r0, r1, start, pre, chirp, frame, nchirps=CHIRPS_TO_AVG):
+    """
+    Cut up to nchirps chirps from both channels starting at the frame offset
+    and mix them with the reference chirp.
+
+    Returns:
+        (beat0, beat1) as (chirps, samples) arrays, or None if no full frame
+        fits after start.
+    """
     Npre = len(pre)
     Nchirp = len(chirp)
     Nframe = len(frame)
 
-    r0, r1 = acquire_accumulated_rx(sdr)
-
-    start = earliest_strong_peak_start_frame_aligned(
-        r0,
-        pre,
-        nframe=Nframe,
-        thresh_ratio=PEAK_THRESH_RATIO,
-        min_start=0
-    )
-
-    #if start is None:
-        #return None
-
     max_frames = (min(r0.size, r1.size) - start) // Nframe
-    use_frames = min(max_frames, CHIRPS_TO_AVG)
+    use_frames = min(max_frames, nchirps)
 
-    #if use_frames < 4:
-        #return None
+    if use_frames < 1:
+        return None
 
     seg0 = r0[start:start + use_frames * Nframe].reshape(use_frames, Nframe)
     seg1 = r1[start:start + use_frames * Nframe].reshape(use_frames, Nframe)
@@ -538,87 +1661,165 @@ def process_once(sdr, pre, chirp, frame, bg_state):
     else:
         ref = np.conjugate(chirp)
 
-    beat0 = (chirp0 * ref[None, :]).reshape(-1)
-    beat1 = (chirp1 * ref[None, :]).reshape(-1)
-
-    det = detect_target_bin_with_bg(
-        beat0,
-        beat1,
-        FS,
-        FB_MIN_HZ,
-        FB_MAX_HZ,
-        bg_state["bg0"],
-        bg_state["bg1"]
+    return chirp0 * ref[None, :], chirp1 * ref[None, :]
+
+
+def strongest_cell_target(det, q_avg):
+    """
+    Single target from the strongest cell, scored by peak-to-median ratio.
+
+    Returns:
+        (range_m, angle_deg, quality, velocity_mps, snr_db)
+    """
+    fb = det["fb_hz"]
+    velocity_mps = det.get("velocity_mps", 0.0)
+    p2m = det["p2m"]
+
+    range_m = two_way_range_from_fb(fb, B_SWEEP, T_CHIRP)
+
+    angle_deg = estimate_angle_from_target_bin(
+        det["X0"],
+        det["X1"],
+        det["bin_index"],
+        D_RX,
+        FC
     )
 
-    #if det is None:
-        #return None
+    quality = 0.5 * min(p2m / 10.0, 1.0) + 0.5 * min(q_avg / 0.5, 1.0)
+    quality = float(np.clip(quality, 0.0, 1.0))
 
-    # fb = det["fb_hz"]
-    # p2m = det["p2m"]
+    if p2m < MIN_PEAK_TO_MEDIAN or q_avg < MIN_COHERENCE:
+        quality *= 0.25
 
-    # range_m = two_way_range_from_fb(fb, B_SWEEP, T_CHIRP)
+    snr_db = 20.0 * np.log10(max(p2m, 1e-12))
 
-    # angle_deg = estimate_angle_from_target_bin(
-        # det["X0"],
-        # det["X1"],
-        # det["bin_index"],
-        # D_RX,
-        # FC
-    # )
-    
-    if det is None:
-        range_m = 0.0
-        angle_deg = 0.0
-        quality = 0.0
-        return range_m, angle_deg, quality
-        
-    if isinstance(det, (int, float, np.integer, np.floating)):
-        fb = float(det)
-        range_m = two_way_range_from_fb(fb, B_SWEEP, T_CHIRP)
-        angle_deg = 0.0
-        quality = 0.1
-        return range_m, angle_deg, quality
-        
-    try:
-        fb = float(det["fb_hz"])
-    except Exeption:
-        fb = 0.0
-        
-    try:
-        range_m = two_way_range_from_fb(fb, B_SWEEP, T_CHIRP)
-    except Exception:
-        range_m = 0.0
-        
-    try:
-        angle_deg = estimate_angle_from_target_bin(
-            det["idx"],
-            det["X0"],
-            det["X1"],
-            d=C/(2*FC),
-            lam=C/FC,
+    return range_m, angle_deg, quality, velocity_mps, snr_db
+
+
+def add_stage_time(stats, stage, t0):
+    """
+    Accumulate the time since t0 (perf_counter) into a processing stage.
+    """
+    if stats is None:
+        return
+
+    dt = time.perf_counter() - t0
+    stats["stage_sum"][stage] += dt
+    stats["stage_max"][stage] = max(stats["stage_max"][stage], dt)
+
+
+def process_block(r0, r1, pre, chirp, frame, bg_state, sync_state=None, stats=None,
+                  outputs=None):
+    """
+    Run sync, dechirp and detection on one accumulated two-channel RX block.
+
+    sync_state enables the tracked frame sync. Without it every block gets a
+    full FFT correlation. stats, if given, collects per-stage timing.
+    outputs, if given, receives the range profile of this block ("profile").
+
+    Returns:
+        list of (range_m, angle_deg, quality, velocity_mps, snr_db),
+        strongest first; empty when nothing was detected
+    """
+    Nframe = len(frame)
+
+    t0 = time.perf_counter()
+
+    if sync_state is not None:
+        start = track_frame_start(r0, pre, Nframe, sync_state)
+    else:
+        start = earliest_strong_peak_start_frame_aligned(
+            r0,
+            pre,
+            nframe=Nframe,
+            thresh_ratio=PEAK_THRESH_RATIO,
+            min_start=0
         )
-    except Exception:
-        angle_deg = 0.0
-        
-    try:
-        quality = float(det.get("quality", 1.0))
-    except Exception:
-        quality = 1.0
-        
-    #return range_m, angle_deg, quality
+
+    add_stage_time(stats, "sync", t0)
+
+    if start is None:
+        return []
+
+    if RANGE_DOPPLER_ENABLED:
+        nchirps = min(DOPPLER_CHIRPS, (RX_BUF - start) // Nframe)
+    else:
+        nchirps = CHIRPS_TO_AVG
+
+    t0 = time.perf_counter()
+
+    beats = dechirp_block(r0, r1, start, pre, chirp, frame, nchirps)
+
+    add_stage_time(stats, "dechirp", t0)
+
+    if beats is None:
+        return []
+
+    beat0 = beats[0].reshape(-1)
+    beat1 = beats[1].reshape(-1)
+
+    # With CFAR the clutter map is a detection floor rather than subtracted.
+    if CLUTTER_ENABLED and CFAR_ENABLED:
+        bg_sub = (None, None)
+    else:
+        bg_sub = (bg_state["bg0"], bg_state["bg1"])
+
+    t0 = time.perf_counter()
+
+    if RANGE_DOPPLER_ENABLED:
+        det = detect_target_rd_with_bg(
+            beats[0],
+            beats[1],
+            Nframe,
+            FS,
+            FB_MIN_HZ,
+            FB_MAX_HZ,
+            bg_sub[0],
+            bg_sub[1]
+        )
+    else:
+        det = detect_target_bin_with_bg(
+            beat0,
+            beat1,
+            FS,
+            FB_MIN_HZ,
+            FB_MAX_HZ,
+            bg_sub[0],
+            bg_sub[1]
+        )
+
+    add_stage_time(stats, "spectrum", t0)
+
+    if det is None:
+        return []
+
+    t0 = time.perf_counter()
 
     q0 = coherence_metric(beat0)
     q1 = coherence_metric(beat1)
     q_avg = 0.5 * (q0 + q1)
 
-    quality = 0.5 * min(p2m / 10.0, 1.0) + 0.5 * min(q_avg / 0.5, 1.0)
-    quality = float(np.clip(quality, 0.0, 1.0))
+    if CFAR_ENABLED:
+        if CLUTTER_ENABLED:
+            clutter = clutter_floor(bg_state, det)
+        else:
+            clutter = None
 
-    if p2m < MIN_PEAK_TO_MEDIAN or q_avg < MIN_COHERENCE:
-        quality *= 0.25
+        if clutter is not None:
+            clutter = clutter ** 2
+
+        targets = cfar_detect_targets(det, q_avg, clutter)
+    else:
+        targets = [strongest_cell_target(det, q_avg)]
 
-    if bg_state["init_count"] < BG_INIT_FRAMES:
+    if targets:
+        quality = targets[0][2]
+    else:
+        quality = 0.0
+
+    if CLUTTER_ENABLED:
+        update_clutter_map(bg_state, det, det.get("target_cells", []))
+    elif bg_state["init_count"] < BG_INIT_FRAMES:
         bg_state["bg0"] = update_background(bg_state["bg0"], det["mag0"], 0.0)
         bg_state["bg1"] = update_background(bg_state["bg1"], det["mag1"], 0.0)
         bg_state["init_count"] += 1
@@ -626,117 +1827,468 @@ def process_once(sdr, pre, chirp, frame, bg_state):
         if quality < BG_FREEZE_QUALITY:
             bg_state["bg0"] = update_background(bg_state["bg0"], det["mag0"], BG_ALPHA)
             bg_state["bg1"] = update_background(bg_state["bg1"], det["mag1"], BG_ALPHA)
-    
-    if mag is not None and len(mag) > 0:
-        print("mag len:", len(mag), "max:", np.max(mag), "min", np.min(mag), flush=True)
+
+    add_stage_time(stats, "detection", t0)
+
+    if outputs is not None:
+        if CLUTTER_ENABLED and CFAR_ENABLED:
+            clutter_mag = clutter_floor(bg_state, det)
+        else:
+            clutter_mag = None
+
+        outputs["profile"] = range_profile(det, clutter_mag)
+
+    return targets
+
+
+def process_once(sdr, pre, chirp, frame, bg_state, sync_state=None):
+    """
+    Acquire one block and process it, strictly in sequence.
+    """
+    r0, r1 = acquire_accumulated_rx(sdr)
+
+    return process_block(r0, r1, pre, chirp, frame, bg_state, sync_state)
+
+
+def range_profile(det, clutter_mag=None):
+    """
+    Strongest return over Doppler of every range bin, above the clutter map
+    magnitude if one is given.
+
+    Returns:
+        dict with range_m (bin centres), mag and angle_deg per bin
+    """
+    mag = np.atleast_2d(det["mag_sum_sub"])
+
+    if clutter_mag is not None:
+        mag = np.maximum(mag - np.atleast_2d(clutter_mag), 0.0)
+
+    d_best = np.argmax(mag, axis=0)
+    peak = mag[d_best, np.arange(mag.shape[1])]
+
+    angle = np.array([
+        estimate_angle_from_target_bin(det["map0"][d], det["map1"][d], k, D_RX, FC)
+        for k, d in enumerate(d_best)
+    ])
+
+    range_m = np.array([two_way_range_from_fb(f, B_SWEEP, T_CHIRP) for f in det["freqs"]])
+
+    return {
+        "range_m": range_m,
+        "mag": peak,
+        "angle_deg": angle,
+    }
+
+
+def make_profile_packet(profile, seq):
+    """
+    Quantized, delta-encoded range profile line, see RANGE_PROFILE_* above.
+
+    Example:
+        #P,17,-12,2928,2928,8003fd02...\n
+    """
+    range_m = profile["range_m"]
+    mag = profile["mag"]
+    angle = profile["angle_deg"]
+
+    # Two bytes per bin; max-pool neighbouring bins until it fits.
+    pool = 1
+    while 2 * int(np.ceil(mag.size / pool)) > RANGE_PROFILE_MAX_BYTES:
+        pool += 1
+
+    if range_m.size > 1:
+        dr = range_m[1] - range_m[0]
     else:
-        print("mag is empty", flush=True)
+        dr = 0.0
+
+    if pool > 1:
+        nb = int(np.ceil(mag.size / pool))
+        mag_p = np.pad(mag, (0, nb * pool - mag.size)).reshape(nb, pool)
+        best = np.argmax(mag_p, axis=1) + np.arange(nb) * pool
+        mag = mag[best]
+        angle = angle[best]
+
+    start_m = range_m[0] + 0.5 * (pool - 1) * dr
+    step_m = dr * pool
+
+    db = 20.0 * np.log10(np.maximum(mag, 1e-12))
+
+    floor_half_db = int(np.floor(2.0 * (db.max() - RANGE_PROFILE_DYNAMIC_DB)))
+    level = np.clip(np.round(2.0 * db - floor_half_db), 0, 255).astype(np.int32)
+
+    # Deltas against what the decoder will reconstruct, so clamping a large
+    # step does not make the rest of the profile drift.
+    payload = bytearray([int(level[0])])
+    prev = int(level[0])
+
+    for q in level[1:]:
+        delta = int(np.clip(int(q) - prev, -128, 127))
+        payload.append(delta & 0xFF)
+        prev += delta
 
-    return range_m, angle_deg, quality
+    for a in angle:
+        payload.append(int(np.clip(np.round(a), -90, 90)) & 0xFF)
+
+    return (
+        f"#P,{seq & 0xFFFF},{floor_half_db},{int(round(start_m * 100.0))},"
+        f"{int(round(step_m * 100.0))},{payload.hex()}\n"
+    )
 
 
-def make_ascii_packet(range_m, angle_deg, quality):
+def make_ascii_packet(targets):
     """
     Packet sent to STM32.
 
-    Format:
-        range_m,angle_deg,quality\n
+    Format, one group per target, strongest first:
+        range_m,angle_deg,quality,velocity_mps;range_m,...\n
+
+    velocity_mps is range rate; negative means the target is closing.
+    With no detection a single all-zero group is sent.
 
     Example:
-        2.431,-7.52,0.81\n
+        2.431,-7.52,0.81,-0.63;7.102,12.40,0.55,0.00\n
+    """
+    if not targets:
+        targets = [(0.0, 0.0, 0.0, 0.0)]
+
+    groups = [
+        f"{t[0]:.3f},{t[1]:.2f},{t[2]:.2f},{t[3]:.2f}"
+        for t in targets
+    ]
+
+    return ";".join(groups) + "\n"
+
+
+# -------------------------------------------------
+# Acquisition pipeline
+# -------------------------------------------------
+
+def put_latest(block_queue, block, stats):
+    """
+    Queue a block for processing, dropping the oldest waiting block if the
+    processing thread has fallen behind.
     """
-    return f"{range_m:.3f},{angle_deg:.2f},{quality:.2f}\n"
+    while True:
+        try:
+            block_queue.put_nowait(block)
+            return
+        except queue.Full:
+            try:
+                block_queue.get_nowait()
+                stats["dropped"] += 1
+            except queue.Empty:
+                pass
+
+
+def acquisition_worker(sdr, block_queue, stop_event, stats, discard_reads=DISCARD_RX_READS):
+    """
+    Pulls accumulated Pluto blocks until stop_event is set.
+
+    Each block carries the time its acquisition started so the processing
+    side can measure end-to-end latency and drop blocks older than a TX
+    change. With discard_reads=0 reads run back to back; the single kernel
+    buffer is then never older than the previous read, so t_acq is also the
+    time of the first sample.
+    """
+    while not stop_event.is_set():
+        t_acq = time.monotonic()
+
+        try:
+            r0, r1 = acquire_accumulated_rx(sdr, discard_reads)
+        except Exception as e:
+            print("Radar acquisition error:", repr(e), flush=True)
+            time.sleep(0.1)
+            continue
+
+        block = {
+            "r0": r0,
+            "r1": r1,
+            "t_acq": t_acq,
+        }
+
+        put_latest(block_queue, block, stats)
+
+
+def start_acquisition(sdr, stats, discard_reads=DISCARD_RX_READS):
+    """
+    Starts the acquisition worker thread.
+
+    Returns:
+        (block_queue, stop_event, thread)
+    """
+    block_queue = queue.Queue(maxsize=PIPELINE_QUEUE_DEPTH)
+    stop_event = threading.Event()
+
+    thread = threading.Thread(
+        target=acquisition_worker,
+        args=(sdr, block_queue, stop_event, stats, discard_reads),
+        name="radar_acq",
+        daemon=True,
+    )
+    thread.start()
+
+    return block_queue, stop_event, thread
+
+
+def stop_acquisition(stop_event, thread):
+    stop_event.set()
+    thread.join(timeout=2.0)
+
+
+def new_pipeline_stats():
+    return {
+        "t_start": time.monotonic(),
+        "blocks": 0,
+        "packets": 0,
+        "dropped": 0,
+        "latency_sum": 0.0,
+        "latency_max": 0.0,
+        "stage_sum": dict.fromkeys(STAGES, 0.0),
+        "stage_max": dict.fromkeys(STAGES, 0.0),
+    }
+
+
+def format_stage_times(stats, blocks):
+    """
+    One line of per-stage average / max processing time in ms.
+    """
+    parts = [
+        f"{stage} {1000.0 * stats['stage_sum'][stage] / blocks:.2f}/"
+        f"{1000.0 * stats['stage_max'][stage]:.2f}"
+        for stage in STAGES
+    ]
 
+    return "Stages avg/max ms: " + ", ".join(parts)
+
+
+def report_pipeline_stats(stats, sync_state=None):
+    """
+    Prints packets per second and end-to-end detection latency
+    (acquisition start to packet written), then resets the window.
+    """
+    now = time.monotonic()
+    elapsed = now - stats["t_start"]
+
+    if elapsed < STATS_PERIOD_S:
+        return
+
+    pps = stats["packets"] / elapsed
+
+    if stats["blocks"] > 0:
+        lat_avg_ms = 1000.0 * stats["latency_sum"] / stats["blocks"]
+    else:
+        lat_avg_ms = 0.0
+
+    lat_max_ms = 1000.0 * stats["latency_max"]
+
+    print(
+        f"Radar stats: {pps:.1f} packets/s, "
+        f"latency avg {lat_avg_ms:.0f} ms max {lat_max_ms:.0f} ms, "
+        f"{stats['blocks']} blocks, {stats['dropped']} dropped",
+        flush=True
+    )
+
+    if stats["blocks"] > 0:
+        print(format_stage_times(stats, stats["blocks"]), flush=True)
+
+    if sync_state is not None:
+        print(
+            f"Sync: {sync_state['tracked']} tracked, "
+            f"{sync_state['reacquired']} full re-acquisitions, "
+            f"quality {sync_state['quality']:.2f}",
+            flush=True
+        )
+        sync_state["tracked"] = 0
+        sync_state["reacquired"] = 0
+
+    stats["t_start"] = now
+    stats["blocks"] = 0
+    stats["packets"] = 0
+    stats["dropped"] = 0
+    stats["latency_sum"] = 0.0
+    stats["latency_max"] = 0.0
+    stats["stage_sum"] = dict.fromkeys(STAGES, 0.0)
+    stats["stage_max"] = dict.fromkeys(STAGES, 0.0)
+
+
+def send_packet(ser, msg):
+    try:
+        ser.write(msg.encode("ascii"))
+    except serial.SerialTimeoutException:
+        print("Warning: USB serial write timeout", flush=True)
+        return False
+    except serial.SerialException as e:
+        print("USB serial error:", e, flush=True)
+        time.sleep(1.0)
+        return False
+
+    if PRINT_PACKETS:
+        print("PI -> STM:", msg.strip(), flush=True)
+
+    return True
+
+
+def parse_args(argv=None):
+    parser = argparse.ArgumentParser(description="Pluto Plus FMCW radar, USB serial output to STM32")
+
+    parser.add_argument("--capture", metavar="DIR",
+                        help="also write every RX block to DIR as .npz")
+    parser.add_argument("--replay", metavar="PATH",
+                        help="process recorded .npz blocks (file or directory) instead of the Pluto")
+    parser.add_argument("--loop", action="store_true",
+                        help="loop the replay recording")
+    parser.add_argument("--serial", action="store_true",
+                        help="send replayed packets to the STM32 as well")
+    parser.add_argument("--profile", action="store_true",
+                        help="also stream the compressed range profile")
+    parser.add_argument("--clutter-map", action="store_true",
+                        help="start a replay from the saved clutter map (it is still not saved)")
+
+    return parser.parse_args(argv)
+
+
+def main(argv=None):
+    global RANGE_PROFILE_ENABLED
+
+    args = parse_args(argv)
+
+    if args.profile:
+        RANGE_PROFILE_ENABLED = True
+
+    replay = args.replay is not None
 
-def main():
     print("Starting Pluto Plus FMCW radar on Raspberry Pi 3")
+    if replay:
+        print("Input: recorded IQ replay")
     print("Output mode: USB serial to STM32")
-    print("Packet format: range_m,angle_deg,quality\\n")
+    print("Packet format: range_m,angle_deg,quality,velocity_mps[;...]\\n")
 
     sdr = None
     ser = None
+    acq_stop = None
+    acq_thread = None
+    stats = None
+    bg_state = None
 
     try:
-        sdr = setup_pluto()
+        if replay:
+            sdr = open_replay(args.replay)
+            sdr["loop"] = args.loop or REPLAY_LOOP
+        else:
+            sdr = setup_pluto()
 
         pre, chirp, frame, tx_wave = build_tx_frame()
-        start_tx(sdr, tx_wave)
 
-        ser = open_usb_serial()
+        if not replay:
+            start_tx(sdr, tx_wave)
+
+        if not replay or args.serial:
+            ser = open_usb_serial()
+
+        capture = None
+        if args.capture:
+            capture = new_capture(args.capture)
+            print(f"Capturing RX blocks to {args.capture}")
+
+        # Replay runs sequentially so every recorded block is processed.
+        pipelined = PIPELINE_ENABLED and not replay
 
         last_send = 0.0
+        last_profile = 0.0
+        profile_seq = 0
 
-        bg_state = {
-            "bg0": None,
-            "bg1": None,
-            "init_count": 0,
-        }
+        # A replay must not overwrite the map learned on the water.
+        bg_state = new_background_state(load=(not replay) or args.clutter_map,
+                                        persist=not replay)
+
+        sync_state = new_sync_state()
+
+        stats = new_pipeline_stats()
+
+        if pipelined:
+            block_queue, acq_stop, acq_thread = start_acquisition(sdr, stats)
 
         while True:
-            # result = process_once(sdr, pre, chirp, frame, bg_state)
+            if pipelined:
+                try:
+                    block = block_queue.get(timeout=PIPELINE_GET_TIMEOUT_S)
+                except queue.Empty:
+                    print("Warning: no RX block from acquisition thread", flush=True)
+                    continue
+            else:
+                t_acq = time.monotonic()
+                try:
+                    r0, r1 = acquire_accumulated_rx(sdr)
+                except EOFError:
+                    print("End of replay")
+                    break
+                block = {"r0": r0, "r1": r1, "t_acq": t_acq}
 
-            # if result is None:
-                # continue
+            capture_block(capture, block)
+
+            if RANGE_PROFILE_ENABLED and time.monotonic() - last_profile >= RANGE_PROFILE_PERIOD_S:
+                outputs = {}
+            else:
+                outputs = None
 
-            # range_m, angle_deg, quality = result
-            # msg = make_utf8_packet(range_m, angle_deg, quality)
-            try:
-                result = process_once(sdr, pre, chirp, frame, bg_state)
-            except Exception as e:
-                printf("Radar processing error:", repr(e), flush=True)
-                result = (0.0, 0.0, 0.0)
-                
-            if result is None:
-                result = (0.0, 0.0, 0.0)
-                
             try:
-                range_m, angle_deg, quality = result
+                targets = process_block(
+                    block["r0"], block["r1"], pre, chirp, frame, bg_state, sync_state, stats,
+                    outputs
+                )
             except Exception as e:
-                print("Bad radar result format:", result, e, flush=True)
-                range_m, angle_deg, quality = 0.0, 0.0, 0.0
-                
-            msg = make_ascii_packet(range_m, angle_deg, quality)
-            
-            now = time.time()
-            
-            if now - last_send >= MIN_SEND_PERIOD_S:
-                try:
-                    ser.write(msg.encode("ascii"))
-                except serial.SerialTimeoutException:
-                    print("Warning: USB serial write timeout", flush=True)
-                except serial.SerialException as e:
-                    print("USB serial error:", e, flush=True)
-                    print.sleep(1.0)
-                    
-                if PRINT_PACKETS:
-                    print("PI -> STM:", msg.strip(), flush=True)
-                    
-                last_send = now
+                print("Radar processing error:", repr(e), flush=True)
+                targets = []
 
-            now = time.time()
+            t0 = time.perf_counter()
+            msg = make_ascii_packet(targets)
+            add_stage_time(stats, "packet", t0)
 
-            if now - last_send >= MIN_SEND_PERIOD_S:
-                try:
-                    ser.write(msg.encode("utf-8"))
-                    print("PI -> STM:", msg.strip(), flush=True)
-                except serial.SerialTimeoutException:
-                    print("Warning: USB serial write timeout")
-                except serial.SerialException as e:
-                    print("USB serial error:", e)
-                    time.sleep(1.0)
+            now = time.monotonic()
 
+            if ser is None:
                 if PRINT_PACKETS:
-                    print(msg.strip())
+                    print("RADAR:", msg.strip(), flush=True)
+                stats["packets"] += 1
+            elif now - last_send >= MIN_SEND_PERIOD_S:
+                if send_packet(ser, msg):
+                    stats["packets"] += 1
 
                 last_send = now
 
+            if outputs is not None and "profile" in outputs:
+                msg = make_profile_packet(outputs["profile"], profile_seq)
+                profile_seq += 1
+                last_profile = now
+
+                if ser is None:
+                    if PRINT_PACKETS:
+                        print("RADAR:", msg.strip(), flush=True)
+                else:
+                    send_packet(ser, msg)
+
+            latency = time.monotonic() - block["t_acq"]
+            stats["blocks"] += 1
+            stats["latency_sum"] += latency
+            stats["latency_max"] = max(stats["latency_max"], latency)
+
+            report_pipeline_stats(stats, sync_state)
+
     except KeyboardInterrupt:
         print("\nStopped by user")
 
     finally:
         print("Cleaning up")
 
-        if sdr is not None:
+        if stats is not None and stats["blocks"] > 0:
+            print(format_stage_times(stats, stats["blocks"]))
+
+        if acq_thread is not None:
+            stop_acquisition(acq_stop, acq_thread)
+
+        save_clutter_map(bg_state)
+
+        if sdr is not None and not replay:
             try:
                 sdr.tx_destroy_buffer()
             except Exception:
@@ -20,7 +20,12 @@ typedef enum {
   MOVE = 1,
   ANCHOR = 2,
   FOLLOW_SHORE = 3,
-  MOTOR_OVERRIDE = 4
+  MOTOR_OVERRIDE = 4,
+  MOTOR_CALIBRATE = 5,
+  CRUISE = 6,
+  WAYPOINT = 7,
+  LOITER = 8,
+  ANCHOR_WEATHERVANE = 9
 } operatingMode;
 
 typedef enum {
@@ -67,4 +72,29 @@ typedef struct {
   UTCDate    utc_date;
   UTCTime    utc_time;
   uint8_t    device_id[5];
-} GPSDataStruct;
\ No newline at end of file
+} GPSDataStruct;
+
+typedef struct {
+  bool    valid;
+  float   value;
+  uint8_t status;
+} RadarParamState;
+
+typedef struct {
+  bool    valid;
+  uint8_t index;
+  uint8_t count;
+  uint8_t state;
+  bool    uploadRejected;
+  float   distanceM;
+  float   crossTrackM;
+} WaypointProgress;
+
+typedef struct {
+  bool    valid;
+  uint8_t state;
+  uint8_t radiusM;
+  float   distanceM;
+  uint16_t powerW;
+  uint8_t dutyPct;
+} LoiterStatus;
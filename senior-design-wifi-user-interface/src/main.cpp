@@ -15,9 +15,39 @@ unsigned long lastGpsMillis = 0;
 
 static const uint8_t GPS_START_BYTE = 0xAA;
 static const size_t GPS_PAYLOAD_LEN = 84;
-uint8_t gpsPayload[GPS_PAYLOAD_LEN];
-size_t gpsPayloadIndex = 0;
-bool gpsSync = false;
+
+// Radar parameter get / set (ids are RADAR_PARAMS in radar_usb.py)
+static const uint8_t RADAR_PARAM_START_BYTE = 0x68;
+static const uint8_t RADAR_PARAM_REPLY_START_BYTE = 0xAB;
+static const size_t RADAR_PARAM_REPLY_PAYLOAD_LEN = 7;
+static const uint8_t RADAR_PARAM_COUNT = 15;
+
+RadarParamState radarParams[RADAR_PARAM_COUNT];
+
+// Waypoint route upload and progress (see waypoint.h on the STM32)
+static const uint8_t WAYPOINT_START_BYTE = 0x6B;
+static const uint8_t WAYPOINT_TELEMETRY_START_BYTE = 0xAC;
+static const size_t WAYPOINT_TELEMETRY_PAYLOAD_LEN = 7;
+static const uint8_t WAYPOINT_MAX = 32;
+
+WaypointProgress waypointProgress;
+
+// Loiter status (see loiter.h on the STM32)
+static const uint8_t LOITER_TELEMETRY_START_BYTE = 0xAD;
+static const size_t LOITER_TELEMETRY_PAYLOAD_LEN = 7;
+
+LoiterStatus loiterStatus;
+
+// Geofence upload (see geofence.h on the STM32)
+static const uint8_t GEOFENCE_START_BYTE = 0x6C;
+static const uint8_t GEOFENCE_MAX_POLYGONS = 4;
+static const uint8_t GEOFENCE_MAX_VERTICES = 16;
+
+// STM32 frames: start byte, then a fixed payload per frame type
+uint8_t stmPayload[GPS_PAYLOAD_LEN];
+size_t stmPayloadIndex = 0;
+size_t stmPayloadLen = 0;
+uint8_t stmFrameType = 0;
 
 unsigned long lastBlink = 0;
 
@@ -47,8 +77,13 @@ void handleRoot() {
   html += "<button class=\"button mode-btn\" onclick=\"selectMode(2)\">Anchor</button>";
   html += "<button class=\"button mode-btn\" onclick=\"selectMode(3)\">Follow Shoreline</button>";
   html += "<button class=\"button mode-btn\" onclick=\"selectMode(4)\">Manual Motors</button>";
+  html += "<button class=\"button mode-btn\" onclick=\"selectMode(5)\">Calibrate Motors</button>";
+  html += "<button class=\"button mode-btn\" onclick=\"selectMode(6)\">Cruise</button>";
+  html += "<button class=\"button mode-btn\" onclick=\"selectMode(7)\">Waypoints</button>";
+  html += "<button class=\"button mode-btn\" onclick=\"selectMode(8)\">Loiter</button>";
+  html += "<button class=\"button mode-btn\" onclick=\"selectMode(9)\">Anchor Into Drift</button>";
 
-  // Direction section (mode 1 only)
+  // Direction section (modes 1 and 6)
   html += "<div id=\"dirSection\" style=\"display:none; margin-top:20px;\">";
   html += "<h2 style=\"text-align:center; color:white;\">Direction:</h2>";
   html += "<button class=\"button dir-btn\" onclick=\"selectDir(2)\">Forward</button>";
@@ -57,7 +92,20 @@ void handleRoot() {
   html += "<button class=\"button dir-btn\" onclick=\"selectDir(1)\">Turn Right</button>";
   html += "</div>";
 
-  // Global speed section (modes 1 and 3)
+  // Route section (mode 7 only): one "lat,lon" per line
+  html += "<div id=\"routeSection\" style=\"display:none;\">";
+  html += "<h2>Route</h2>";
+  html += "<textarea id=\"routeText\" rows=\"6\" style=\"width:90%; font-size:16px;\" placeholder=\"42.000500,-71.000000\"></textarea>";
+  html += "<button class=\"button\" onclick=\"uploadRoute()\" style=\"background-color:#0066cc;\">Upload Route</button>";
+  html += "<div style=\"color:white;\">Progress: <span id=\"routeStatus\">--</span></div>";
+  html += "</div>";
+
+  // Loiter status (mode 8 only)
+  html += "<div id=\"loiterSection\" style=\"display:none;\">";
+  html += "<div style=\"color:white;\">Loiter: <span id=\"loiterStatus\">--</span></div>";
+  html += "</div>";
+
+  // Global speed section (modes 1, 3, 6, 7 and 8)
   html += "<div id=\"speedSection\" style=\"display:none; margin-top:20px;\">";
   html += "<h2 style=\"text-align:center; color:white;\">Speed: <span id=\"speedVal\">0</span>%</h2>";
   html += "<input type=\"range\" min=\"0\" max=\"100\" value=\"0\" id=\"speedSlider\" style=\"width:90%; height:25px;\">";
@@ -115,6 +163,20 @@ void handleRoot() {
   html += "<h1 style=\"text-align:left;\">Sonar: <span style=\"color:#00ff00;\">ON</span></h1>";
   html += "<h1 style=\"text-align:left;\">Radar: <span id=\"radarStatus\" style=\"color:#ff3333;\">OFF</span></h1>";
   html += "<button class=\"button\" id=\"radarToggleBtn\" onclick=\"toggleRadar()\" style=\"margin-top:10px; background-color:#0066cc;\">RADAR: OFF</button>";
+
+  // Radar tuning, applied live on the Pi
+  html += "<h2 style=\"color:white; margin-top:20px;\">Radar Tuning</h2>";
+  html += "<select id=\"paramId\" style=\"width:90%; font-size:16px; padding:6px;\" onchange=\"showParam()\"></select>";
+  html += "<input type=\"number\" step=\"any\" id=\"paramVal\" style=\"width:90%; font-size:16px; padding:6px; margin-top:8px;\">";
+  html += "<button class=\"button\" onclick=\"sendParam(0)\" style=\"background-color:#0066cc;\">Read</button>";
+  html += "<button class=\"button\" onclick=\"sendParam(1)\" style=\"background-color:#0066cc;\">Apply</button>";
+  html += "<div style=\"color:white;\">Radar value: <span id=\"paramCur\">--</span></div>";
+
+  // Geofence, one polygon per line: "in:" or "out:" then "lat,lon;lat,lon;..."
+  html += "<h2 style=\"color:white; margin-top:20px;\">Geofence</h2>";
+  html += "<textarea id=\"fenceText\" rows=\"4\" style=\"width:90%; font-size:16px;\" placeholder=\"in:42.0001,-71.0001;42.0001,-70.9990;42.0010,-70.9990\"></textarea>";
+  html += "<button class=\"button\" onclick=\"uploadFence()\" style=\"background-color:#0066cc;\">Upload Fence</button>";
+  html += "<div style=\"color:white;\">Fence: <span id=\"fenceStatus\">--</span></div>";
   html += "</div>";
   html += "</div>";
 
@@ -153,6 +215,33 @@ void handleRoot() {
   html += "setInterval(updateGps, 1000);";
   html += "updateGps();";
 
+  html += "var paramNames = ['TX gain (dB)', 'RX0 gain (dB)', 'RX1 gain (dB)', 'Beat min (Hz)', 'Beat max (Hz)',";
+  html += "  'CFAR Pfa', 'Max targets', 'Clutter threshold (dB)', 'Clutter learn rate', 'Clutter max speed (m/s)',";
+  html += "  'Min peak/median', 'Min coherence', 'Min send period (s)', 'Range profile (0/1)', 'Profile period (s)'];";
+  html += "var paramStatus = ['OK', 'unknown parameter', 'rejected'];";
+  html += "var paramSel = document.getElementById('paramId');";
+  html += "for(var i = 0; i < paramNames.length; i++) {";
+  html += "  var o = document.createElement('option'); o.value = i; o.textContent = paramNames[i]; paramSel.appendChild(o);";
+  html += "}";
+  html += "function showParam() {";
+  html += "  fetch('/radarparams')";
+  html += "    .then(function(r) { return r.json(); })";
+  html += "    .then(function(d) {";
+  html += "      var p = d.params[paramSel.value];";
+  html += "      document.getElementById('paramCur').textContent =";
+  html += "        p.valid ? (p.value + ' (' + paramStatus[p.status] + ')') : '--';";
+  html += "    })";
+  html += "    .catch(function() {});";
+  html += "}";
+  html += "function sendParam(op) {";
+  html += "  var url = '/radarparam?op=' + op + '&id=' + paramSel.value";
+  html += "          + '&val=' + (document.getElementById('paramVal').value || 0);";
+  html += "  document.getElementById('paramCur').textContent = 'waiting...';";
+  html += "  fetch(url)";
+  html += "    .then(function() { setTimeout(showParam, 1000); })";
+  html += "    .catch(function() {});";
+  html += "}";
+
   html += "function updateMotor(num, val) {";
   html += "  motorSpeeds[num - 1] = parseInt(val);";
   html += "  document.getElementById('m' + num + 'Val').textContent = val;";
@@ -178,6 +267,8 @@ void handleRoot() {
   html += "  document.getElementById('dirSection').style.display    = 'none';";
   html += "  document.getElementById('speedSection').style.display  = 'none';";
   html += "  document.getElementById('motorSection').style.display  = 'none';";
+  html += "  document.getElementById('routeSection').style.display  = 'none';";
+  html += "  document.getElementById('loiterSection').style.display = 'none';";
   html += "  if(mode == 0) {";
   html += "    currentSpeed = 0; currentDir = 2;";
   html += "    document.getElementById('feedback').textContent = 'System disabled';";
@@ -188,13 +279,34 @@ void handleRoot() {
   html += "  } else if(mode == 2) {";
   html += "    currentSpeed = 0; currentDir = 2;";
   html += "    document.getElementById('feedback').textContent = 'Ready to anchor';";
+  html += "  } else if(mode == 9) {";
+  html += "    currentSpeed = 0; currentDir = 2;";
+  html += "    document.getElementById('feedback').textContent = 'Ready to anchor, bow turns into the current';";
   html += "  } else if(mode == 3) {";
+  html += "    document.getElementById('dirSection').style.display   = 'block';";
   html += "    document.getElementById('speedSection').style.display = 'block';";
   html += "    currentDir = 2;";
-  html += "    document.getElementById('feedback').textContent = 'Set speed for shoreline following';";
+  html += "    document.getElementById('feedback').textContent = 'Set speed for shoreline following; Turn Left / Turn Right sets the shore side';";
   html += "  } else if(mode == 4) {";
   html += "    document.getElementById('motorSection').style.display = 'block';";
   html += "    document.getElementById('feedback').textContent = 'Set individual motor speeds';";
+  html += "  } else if(mode == 6) {";
+  html += "    document.getElementById('dirSection').style.display   = 'block';";
+  html += "    document.getElementById('speedSection').style.display = 'block';";
+  html += "    document.getElementById('feedback').textContent = 'Select direction and speed to hold (100 = 1.5 m/s)';";
+  html += "  } else if(mode == 7) {";
+  html += "    document.getElementById('routeSection').style.display = 'block';";
+  html += "    document.getElementById('speedSection').style.display = 'block';";
+  html += "    currentDir = 2;";
+  html += "    document.getElementById('feedback').textContent = 'Upload a route, then set the transit speed';";
+  html += "  } else if(mode == 8) {";
+  html += "    document.getElementById('loiterSection').style.display = 'block';";
+  html += "    document.getElementById('speedSection').style.display = 'block';";
+  html += "    currentDir = 2;";
+  html += "    document.getElementById('feedback').textContent = 'Speed sets the loiter radius in metres (3 minimum)';";
+  html += "  } else if(mode == 5) {";
+  html += "    currentSpeed = 0; currentDir = 2;";
+  html += "    document.getElementById('feedback').textContent = 'Motor sweep takes about 10 minutes, keep clear of obstacles';";
   html += "  }";
   html += "}";
 
@@ -221,7 +333,7 @@ void handleRoot() {
   html += "    document.getElementById('feedback').textContent = 'ERROR: Select a mode!';";
   html += "    return;";
   html += "  }";
-  html += "  if(currentMode == 1 && currentDir === null) {";
+  html += "  if((currentMode == 1 || currentMode == 6) && currentDir === null) {";
   html += "    document.getElementById('feedback').textContent = 'ERROR: Select a direction!';";
   html += "    return;";
   html += "  }";
@@ -243,6 +355,77 @@ void handleRoot() {
   html += "      document.getElementById('feedback').textContent = 'ERROR: Connection failed';";
   html += "    });";
   html += "}";
+  html += "var routeStates = ['no route', 'ready', 'underway', 'arrived'];";
+  html += "function uploadRoute() {";
+  html += "  var lines = document.getElementById('routeText').value.split('\\n');";
+  html += "  var pts = [];";
+  html += "  for(var i = 0; i < lines.length; i++) {";
+  html += "    var p = lines[i].split(',');";
+  html += "    if(p.length == 2 && !isNaN(parseFloat(p[0])) && !isNaN(parseFloat(p[1]))) {";
+  html += "      pts.push(parseFloat(p[0]).toFixed(7) + ',' + parseFloat(p[1]).toFixed(7));";
+  html += "    }";
+  html += "  }";
+  html += "  if(pts.length == 0 || pts.length > 32) {";
+  html += "    document.getElementById('routeStatus').textContent = 'ERROR: 1 to 32 points';";
+  html += "    return;";
+  html += "  }";
+  html += "  document.getElementById('routeStatus').textContent = 'uploading ' + pts.length + ' points...';";
+  html += "  fetch('/route?pts=' + pts.join(';')).catch(function() {});";
+  html += "}";
+  html += "function updateRoute() {";
+  html += "  fetch('/waypoints')";
+  html += "    .then(function(r) { return r.json(); })";
+  html += "    .then(function(d) {";
+  html += "      if(!d.valid) { return; }";
+  html += "      document.getElementById('routeStatus').textContent = (d.rejected ? 'upload rejected, ' : '')";
+  html += "        + routeStates[d.state] + ', waypoint '";
+  html += "        + (d.index + 1) + '/' + d.count + ', ' + d.dist_m.toFixed(1) + ' m to go, off track '";
+  html += "        + d.xte_m.toFixed(1) + ' m';";
+  html += "    })";
+  html += "    .catch(function() {});";
+  html += "}";
+  html += "setInterval(updateRoute, 1000);";
+  html += "var loiterStates = ['off', 'drifting', 'correcting'];";
+  html += "function updateLoiter() {";
+  html += "  fetch('/loiter')";
+  html += "    .then(function(r) { return r.json(); })";
+  html += "    .then(function(d) {";
+  html += "      if(!d.valid) { return; }";
+  html += "      document.getElementById('loiterStatus').textContent = loiterStates[d.state] + ', '";
+  html += "        + d.dist_m.toFixed(1) + ' / ' + d.radius_m + ' m from centre, ' + d.power_w + ' Wh per hour, motors on '";
+  html += "        + d.duty + '% of the time';";
+  html += "    })";
+  html += "    .catch(function() {});";
+  html += "}";
+  html += "setInterval(updateLoiter, 1000);";
+  html += "function uploadFence() {";
+  html += "  var lines = document.getElementById('fenceText').value.split('\\n');";
+  html += "  var polys = [];";
+  html += "  for(var i = 0; i < lines.length; i++) {";
+  html += "    var line = lines[i].trim();";
+  html += "    var type = line.indexOf('out:') == 0 ? 'O' : (line.indexOf('in:') == 0 ? 'I' : null);";
+  html += "    if(type == null) { continue; }";
+  html += "    var pts = [];";
+  html += "    var raw = line.substring(line.indexOf(':') + 1).split(';');";
+  html += "    for(var j = 0; j < raw.length; j++) {";
+  html += "      var p = raw[j].split(',');";
+  html += "      if(p.length == 2 && !isNaN(parseFloat(p[0])) && !isNaN(parseFloat(p[1]))) {";
+  html += "        pts.push(parseFloat(p[0]).toFixed(7) + ',' + parseFloat(p[1]).toFixed(7));";
+  html += "      }";
+  html += "    }";
+  html += "    if(pts.length < 3 || pts.length > 16) {";
+  html += "      document.getElementById('fenceStatus').textContent = 'ERROR: 3 to 16 points per polygon';";
+  html += "      return;";
+  html += "    }";
+  html += "    polys.push(type + ':' + pts.join(';'));";
+  html += "  }";
+  html += "  if(polys.length > 4) {";
+  html += "    document.getElementById('fenceStatus').textContent = 'ERROR: at most 4 polygons';";
+  html += "    return;";
+  html += "  }";
+  html += "  document.getElementById('fenceStatus').textContent = polys.length ? ('sent ' + polys.length + ' polygons') : 'cleared';";
+  html += "  fetch('/geofence?polys=' + polys.join('|')).catch(function() {});";
+  html += "}";
   html += "function setRadarStatus(isOn) {";
   html += "  radarOn = isOn;";
   html += "  var status = document.getElementById('radarStatus');";
@@ -371,6 +554,244 @@ void handleRadarCommand() {
   server.send(200, "text/plain", "OK");
 }
 
+// Radar parameter frame
+// Byte 0:   start byte (0x68)
+// Byte 1:   0 = get, 1 = set
+// Byte 2:   parameter id
+// Byte 3-6: value (float, little endian, ignored for get)
+// Byte 7:   0
+void handleRadarParam() {
+  uint8_t op = (uint8_t)server.arg("op").toInt();
+  uint8_t id = (uint8_t)server.arg("id").toInt();
+  float value = server.arg("val").toFloat();
+
+  uint8_t frame[8] = {RADAR_PARAM_START_BYTE, op, id, 0, 0, 0, 0, 0};
+  memcpy(&frame[3], &value, 4);
+
+  if (id < RADAR_PARAM_COUNT) {
+    radarParams[id].valid = false;
+  }
+
+  Serial2.write(frame, sizeof(frame));
+
+  server.send(200, "text/plain", "OK");
+}
+
+// Route upload, one field of one waypoint per frame:
+// Byte 0:   start byte (0x6B)
+// Byte 1:   0 = begin, 1 = latitude, 2 = longitude, 3 = commit
+// Byte 2:   waypoint index (count for begin / commit)
+// Byte 3-6: deg * 1e7 (int32, little endian)
+// Byte 7:   0
+void sendWaypointFrame(uint8_t op, uint8_t index, int32_t value) {
+  uint8_t frame[8] = {WAYPOINT_START_BYTE, op, index, 0, 0, 0, 0, 0};
+  memcpy(&frame[3], &value, 4);
+  Serial2.write(frame, sizeof(frame));
+  // The STM32 re-arms its 8-byte receive in the interrupt; give it time
+  delay(2);
+}
+
+// pts = "lat,lon;lat,lon;..."
+void handleRoute() {
+  String pts = server.arg("pts");
+  int32_t lat[WAYPOINT_MAX];
+  int32_t lon[WAYPOINT_MAX];
+  uint8_t count = 0;
+  int start = 0;
+
+  while (start < (int)pts.length() && count < WAYPOINT_MAX) {
+    int end = pts.indexOf(';', start);
+    if (end < 0) {
+      end = pts.length();
+    }
+    String pt = pts.substring(start, end);
+    int comma = pt.indexOf(',');
+    if (comma > 0) {
+      lat[count] = (int32_t)llround(pt.substring(0, comma).toDouble() * 1e7);
+      lon[count] = (int32_t)llround(pt.substring(comma + 1).toDouble() * 1e7);
+      count++;
+    }
+    start = end + 1;
+  }
+
+  if (count == 0) {
+    server.send(400, "text/plain", "No points");
+    return;
+  }
+
+  sendWaypointFrame(0, count, 0);
+  for (uint8_t i = 0; i < count; ++i) {
+    sendWaypointFrame(1, i, lat[i]);
+    sendWaypointFrame(2, i, lon[i]);
+  }
+  sendWaypointFrame(3, count, 0);
+
+  server.send(200, "text/plain", "OK");
+}
+
+// Geofence frame
+// Byte 0:   start byte (0x6C)
+// Byte 1:   0 = begin, 1 = polygon, 2 = latitude, 3 = longitude, 4 = commit
+// Byte 2-6: see geofence.h on the STM32
+void sendGeofenceFrame(uint8_t op, uint8_t arg, const uint8_t *data, size_t len) {
+  uint8_t frame[8] = {GEOFENCE_START_BYTE, op, arg, 0, 0, 0, 0, 0};
+  if (len > 0) {
+    memcpy(&frame[3], data, len);
+  }
+  Serial2.write(frame, sizeof(frame));
+  delay(2);
+}
+
+// polys = "I:lat,lon;lat,lon;...|O:lat,lon;..." (I = keep in, O = keep out),
+// empty clears the fence
+void handleGeofence() {
+  String polys = server.arg("polys");
+  uint8_t type[GEOFENCE_MAX_POLYGONS];
+  uint8_t count[GEOFENCE_MAX_POLYGONS];
+  int32_t lat[GEOFENCE_MAX_POLYGONS][GEOFENCE_MAX_VERTICES];
+  int32_t lon[GEOFENCE_MAX_POLYGONS][GEOFENCE_MAX_VERTICES];
+  uint8_t polyCount = 0;
+  int start = 0;
+
+  while (start < (int)polys.length() && polyCount < GEOFENCE_MAX_POLYGONS) {
+    int end = polys.indexOf('|', start);
+    if (end < 0) {
+      end = polys.length();
+    }
+    String poly = polys.substring(start, end);
+    start = end + 1;
+
+    if (poly.length() < 2 || poly.charAt(1) != ':') {
+      continue;
+    }
+    type[polyCount] = (poly.charAt(0) == 'O') ? 1 : 0;
+    count[polyCount] = 0;
+
+    int ptStart = 2;
+    while (ptStart < (int)poly.length() && count[polyCount] < GEOFENCE_MAX_VERTICES) {
+      int ptEnd = poly.indexOf(';', ptStart);
+      if (ptEnd < 0) {
+        ptEnd = poly.length();
+      }
+      String pt = poly.substring(ptStart, ptEnd);
+      int comma = pt.indexOf(',');
+      if (comma > 0) {
+        uint8_t v = count[polyCount];
+        lat[polyCount][v] = (int32_t)llround(pt.substring(0, comma).toDouble() * 1e7);
+        lon[polyCount][v] = (int32_t)llround(pt.substring(comma + 1).toDouble() * 1e7);
+        count[polyCount]++;
+      }
+      ptStart = ptEnd + 1;
+    }
+
+    if (count[polyCount] < 3) {
+      server.send(400, "text/plain", "Polygon needs 3 points");
+      return;
+    }
+    polyCount++;
+  }
+
+  sendGeofenceFrame(0, polyCount, NULL, 0);
+  for (uint8_t p = 0; p < polyCount; ++p) {
+    uint8_t shape[2] = {type[p], count[p]};
+    sendGeofenceFrame(1, p, shape, sizeof(shape));
+    for (uint8_t v = 0; v < count[p]; ++v) {
+      uint8_t index = p * GEOFENCE_MAX_VERTICES + v;
+      sendGeofenceFrame(2, index, (const uint8_t *)&lat[p][v], 4);
+      sendGeofenceFrame(3, index, (const uint8_t *)&lon[p][v], 4);
+    }
+  }
+  sendGeofenceFrame(4, polyCount, NULL, 0);
+
+  server.send(200, "text/plain", "OK");
+}
+
+void handleWaypoints() {
+  String json = "{";
+  json += "\"valid\":" + String(waypointProgress.valid ? "true" : "false") + ",";
+  json += "\"index\":" + String(waypointProgress.index) + ",";
+  json += "\"count\":" + String(waypointProgress.count) + ",";
+  json += "\"state\":" + String(waypointProgress.state) + ",";
+  json += "\"rejected\":" + String(waypointProgress.uploadRejected ? "true" : "false") + ",";
+  json += "\"dist_m\":" + String(waypointProgress.distanceM, 1) + ",";
+  json += "\"xte_m\":" + String(waypointProgress.crossTrackM, 1);
+  json += "}";
+
+  server.send(200, "application/json", json);
+}
+
+void handleLoiter() {
+  String json = "{";
+  json += "\"valid\":" + String(loiterStatus.valid ? "true" : "false") + ",";
+  json += "\"state\":" + String(loiterStatus.state) + ",";
+  json += "\"radius_m\":" + String(loiterStatus.radiusM) + ",";
+  json += "\"dist_m\":" + String(loiterStatus.distanceM, 1) + ",";
+  json += "\"power_w\":" + String(loiterStatus.powerW) + ",";
+  json += "\"duty\":" + String(loiterStatus.dutyPct);
+  json += "}";
+
+  server.send(200, "application/json", json);
+}
+
+void handleRadarParams() {
+  String json = "{\"params\":[";
+  for (uint8_t i = 0; i < RADAR_PARAM_COUNT; ++i) {
+    json += "{\"valid\":" + String(radarParams[i].valid ? "true" : "false") + ",";
+    json += "\"value\":" + String(radarParams[i].value, 6) + ",";
+    json += "\"status\":" + String(radarParams[i].status) + "}";
+    if (i < RADAR_PARAM_COUNT - 1) {
+      json += ",";
+    }
+  }
+  json += "]}";
+
+  server.send(200, "application/json", json);
+}
+
+// Reply: id, value (float LE), status, pad
+void decodeRadarParamPayload(const uint8_t *payload) {
+  uint8_t id = payload[0];
+  if (id >= RADAR_PARAM_COUNT) {
+    return;
+  }
+
+  memcpy(&radarParams[id].value, payload + 1, 4);
+  radarParams[id].status = payload[5];
+  radarParams[id].valid = true;
+}
+
+// Progress: index, count, state (bit 7: upload rejected), distance (dm, uint16 LE), cross-track (dm, int16 LE)
+void decodeWaypointPayload(const uint8_t *payload) {
+  uint16_t dist;
+  int16_t cross;
+
+  memcpy(&dist, payload + 3, 2);
+  memcpy(&cross, payload + 5, 2);
+
+  waypointProgress.index = payload[0];
+  waypointProgress.count = payload[1];
+  waypointProgress.state = payload[2] & 0x7F;
+  waypointProgress.uploadRejected = (payload[2] & 0x80) != 0;
+  waypointProgress.distanceM = dist * 0.1f;
+  waypointProgress.crossTrackM = cross * 0.1f;
+  waypointProgress.valid = true;
+}
+
+void decodeLoiterPayload(const uint8_t *payload) {
+  uint16_t dist;
+  uint16_t power;
+
+  memcpy(&dist, payload + 2, 2);
+  memcpy(&power, payload + 4, 2);
+
+  loiterStatus.state = payload[0];
+  loiterStatus.radiusM = payload[1];
+  loiterStatus.distanceM = dist * 0.1f;
+  loiterStatus.powerW = power;
+  loiterStatus.dutyPct = payload[6];
+  loiterStatus.valid = true;
+}
+
 void decodeGpsPayload(const uint8_t *payload) {
   size_t offset = 0;
 
@@ -400,22 +821,39 @@ void decodeGpsPayload(const uint8_t *payload) {
   lastGpsMillis = millis();
 }
 
-void handleGpsUart() {
+void handleStmUart() {
   while (Serial2.available() > 0) {
     uint8_t b = (uint8_t)Serial2.read();
 
-    if (!gpsSync) {
+    if (stmPayloadLen == 0) {
       if (b == GPS_START_BYTE) {
-        gpsSync = true;
-        gpsPayloadIndex = 0;
+        stmPayloadLen = GPS_PAYLOAD_LEN;
+      } else if (b == RADAR_PARAM_REPLY_START_BYTE) {
+        stmPayloadLen = RADAR_PARAM_REPLY_PAYLOAD_LEN;
+      } else if (b == WAYPOINT_TELEMETRY_START_BYTE) {
+        stmPayloadLen = WAYPOINT_TELEMETRY_PAYLOAD_LEN;
+      } else if (b == LOITER_TELEMETRY_START_BYTE) {
+        stmPayloadLen = LOITER_TELEMETRY_PAYLOAD_LEN;
+      } else {
+        continue;
       }
+      stmFrameType = b;
+      stmPayloadIndex = 0;
       continue;
     }
 
-    gpsPayload[gpsPayloadIndex++] = b;
-    if (gpsPayloadIndex >= GPS_PAYLOAD_LEN) {
-      decodeGpsPayload(gpsPayload);
-      gpsSync = false;
+    stmPayload[stmPayloadIndex++] = b;
+    if (stmPayloadIndex >= stmPayloadLen) {
+      if (stmFrameType == GPS_START_BYTE) {
+        decodeGpsPayload(stmPayload);
+      } else if (stmFrameType == WAYPOINT_TELEMETRY_START_BYTE) {
+        decodeWaypointPayload(stmPayload);
+      } else if (stmFrameType == LOITER_TELEMETRY_START_BYTE) {
+        decodeLoiterPayload(stmPayload);
+      } else {
+        decodeRadarParamPayload(stmPayload);
+      }
+      stmPayloadLen = 0;
     }
   }
 }
@@ -489,6 +927,12 @@ void setup() {
   server.on("/command", handleCommand);
   server.on("/radar", handleRadarCommand);
   server.on("/gps", handleGps);
+  server.on("/radarparam", handleRadarParam);
+  server.on("/radarparams", handleRadarParams);
+  server.on("/route", handleRoute);
+  server.on("/waypoints", handleWaypoints);
+  server.on("/geofence", handleGeofence);
+  server.on("/loiter", handleLoiter);
 
   server.begin();
   Serial.println("HTTP server started");
@@ -498,7 +942,7 @@ void setup() {
 
 void loop() {
   server.handleClient();
-  handleGpsUart();
+  handleStmUart();
 
   unsigned long currentMillis = millis();
   if (currentMillis - lastBlink >= 1000) {